@@ -9,139 +9,211 @@
 /* This program implements a solution for the Sudoku problem using standard C++      */
 /* threads.                                                                          */
 /* The structure of the implementation relies on the Divide&Conquer programming      */
-/* paradigm. The program starts with one thread that works on the initial schema.    */
+/* paradigm. The program starts with one task that works on the initial schema.      */
 /* If the program reached the requested depth level of the solution tree then the    */
-/* schema is resolved sequentially by the single thread, otherwise, the solution     */
-/* tree is explored but for every new discovered branch coming from the possible     */
-/* values of a cell, a new thread is started. The new thread is given a copy of the  */
-/* starting schema but with the specified cell value modified according to the       */
-/* branch. The task of the thread will be to explore this new tree recursively.      */
+/* schema is resolved sequentially by the task, otherwise, the solution tree is      */
+/* explored but for every new discovered branch coming from the possible values of   */
+/* a cell, a new task is forked. The new task is given a copy of the starting schema */
+/* but with the specified cell value modified according to the branch. The task      */
+/* will explore this new tree recursively, and its parent joins all of them.         */
+/* Tasks run on a fixed pool of threads (pool.cpp) sized to the machine: a parent    */
+/* waiting for its children runs pending tasks meanwhile, so going deeper in the     */
+/* tree only creates more tasks to balance, never more threads.                      */
 /*                                                                                   */
 /* The schemes emitted are selected from the initial schema, choosing the cell with  */
 /* less possible assignable values and enumerating them all.                         */
 /*                                                                                   */
-/* Usage : <program_name> <par_degree> <board_index>                                 */
+/* Usage : <program_name> [-r rules] [-e engine] [-f input] [-c interval]            */
+/*                        [-w nw] [-k limit] [-a affinity]                           */
+/*                        <par_degree> <board_index>                                 */
 /* Where board_index=which board you want to be resolved in a [0-9] range taken      */
-/* from the "input.txt" file, and par_degree=how many levels of the tree do you want */
-/* to go down before reaching a base case.                                           */
+/* from the input file, par_degree=how many levels of the tree do you want           */
+/* to go down before reaching a base case, nw=number of threads in the pool          */
+/* (default: number of cores),                                                       */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt). With dlx, every  */
+/* task is solved to completion by Dancing Links instead of being split further.     */
+/* interval=nodes explored by a thread between two checks of the cancellation flag   */
+/* raised by the first solution found (default 16).                                  */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* limit=how many solutions to count before stopping (0 for all of them), instead of */
+/* stopping at the first one; the number of solutions found is printed.              */
+/* affinity=placement of the threads on the cpus: compact (one NUMA node after the   */
+/* other), scatter (the nodes in turn), a list of cpus (e.g. 0-3,8) or none (the     */
+/* default, left to the scheduler); see affinity.cpp.                                */
 /*************************************************************************************/
 // #define PRINT_OVERHEAD = 1;
 // #define PRINT_SOLUTION = 1;
+// #define STATS = 1;
 
 #include "utils.cpp"
+#include "deque.cpp"
+#include "pool.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
+#include "affinity.cpp"
 using namespace std;
 
+threadpool *pool;
+
 std::mutex sol_mutex;
-Cell** solution;
+Board solution;
 
 atomic_bool sol_found = false;
+CancelToken cancel_token;
+SolutionCounter counter;
 
-void setSolution(Cell** my_sol);
-bool SolveSudoku(Cell** grid);
+bool setSolution(const Board &my_sol, bool counted = false);
+bool SolveSudoku(Board &grid, Trail &trail);
 static inline void usage(const char *argv0);
-void solve(Cell** grid, int par_degree, int tree_level);
+void solve(Board grid, int par_degree, int tree_level);
 
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    int opt;
+    string input = "input.txt";
+    int nw = thread::hardware_concurrency();
+    while ((opt = getopt(argc, argv, "r:e:f:c:w:k:a:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'c':
+            if ((cancel_token.interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'w':
+            if ((nw = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'k':
+            if ((counter.limit = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'a':
+            if (!parseAffinity(optarg))
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 2)
         usage(argv[0]);
 
-    vector<int**>* grids = new vector<int**>();
-    readGrids(grids, "input.txt");
-
-    int par_degree = atoi(argv[1]);
-    int board_index = atoi(argv[2]);
-
-    solution = new Cell*[N];
-    for(int i=0;i<N;i++)
-        solution[i] = new Cell[N];
+    int par_degree = atoi(argv[optind]);
+    int board_index = atoi(argv[optind + 1]);
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, board_index))
+        usage(argv[0]);
 
-    Cell** filledGrid = fillGrid((*grids)[board_index]);
+    Board filledGrid = fillGrid(puzzle);
+    counter.token = &cancel_token;
+    pool = new threadpool(nw, pinThread);
 	auto start = chrono::high_resolution_clock::now();
-    solve(filledGrid, par_degree, 0);
+    taskgroup root;
+    pool->spawn(root, [&]() { solve(filledGrid, par_degree, 0); });
+    pool->wait(root);
 	auto elapsed = chrono::high_resolution_clock::now() - start;
+    delete pool;
     auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
 #ifdef PRINT_SOLUTION	
     if (sol_found)
         printGrid(solution); 
-    else
+    else if (!counter.counting())
 	 	cout << "No solution exists\n"; 
 #endif
 	cout << "Execution took : " << usec << " usecs." << endl;
+    if (counter.counting())
+        cout << "Solutions : " << counter.total() << endl;
+    printStats();
 	return 0; 
 }
 
-void setSolution(Cell** my_sol)
+// false if the solutions are being counted and the search goes on; counted if solveDLX
+// has already recorded the solution in the counter
+bool setSolution([[maybe_unused]] const Board &my_sol, bool counted)
 {
+    if(counter.counting() && !counted && !counter.found())
+        return false;
     if(!sol_found){
         sol_found = true;
+        cancel_token.cancel();
 #ifdef PRINT_SOLUTION
         std::unique_lock<std::mutex> lock(sol_mutex);
-        for (int i = 0; i < N; i++)
-            for (int j = 0; j < N; j++)
-                solution[i][j].value = my_sol[i][j].value;
+        solution = my_sol;
         lock.unlock();
 #endif
     }
+    return true;
 }
 
-bool SolveSudoku(Cell** grid)
+bool SolveSudoku(Board &grid, Trail &trail)
 {
-    int row, col;
-    if(FindUnassignedMinimumLocation(grid, row, col))
-    {
-        for(int num=1;num<=N;num++)
-        {
-            if(isSafe(grid, row, col, num)){
-                grid[row][col].value = num;
-                calculatePossibleValues(grid);
-                if(SolveSudoku(grid)) return true;
-                grid[row][col].value = UNASSIGNED;
-            }
-        }
-        return false;
-    }
-    setSolution(grid);
-    return true;
+    SearchStack stack;
+    int countdown = 0;
+    return search(grid, trail, stack, [](const Board &solution) { return setSolution(solution); },
+                  [&countdown] { return cancel_token.poll(countdown); });
 }
 
 static inline void usage(const char *argv0)
 {
     printf("--------------------\n");
-    printf("Usage: %s <par_degree> <board_index>\n", argv0);
+    printf("Usage: %s [-r rules] [-e engine] [-f input] [-c interval] [-w nw] [-k limit]\n", argv0);
+    printf("          [-a affinity] <par_degree> <board_index>\n");
     printf("--------------------\n");
     exit(-1);
 }
 
-void solve(Cell** grid, int par_degree, int tree_level)
+void solve(Board grid, int par_degree, int tree_level)
 {
-    if(sol_found) return;
+    STAT_ADD(STAT_NODES, 1);
+    if(cancel_token.cancelled()) return;
+    if(!propagate(grid)){
+        STAT_ADD(STAT_BACKTRACKS, 1);
+        return;
+    }
     if(par_degree==0 || tree_level == par_degree)
     {
 #ifndef PRINT_OVERHEAD
-        SolveSudoku(grid);
+        if(engine == ENGINE_DLX){
+            if(solveDLX(grid, &cancel_token, &counter))
+                setSolution(grid, true);
+            return;
+        }
+        Trail* trail = new Trail();
+        SolveSudoku(grid, *trail);
+        delete trail;
 #else
         return;
 #endif
     }else{
-        std::vector<std::thread> tids;
+        taskgroup children;
         int row, col;
-        RemoveSingletons(grid);
-        bool find = FindUnassignedMinimumLocation(grid, row, col);
-        for(int num : grid[row][col].possible_values){
-            Cell** my_grid = new Cell *[N];
-            for (int r = 0; r < N; r++)
-            {
-                my_grid[r] = new Cell[N];
-                for (int c = 0; c < N; c++)
-                    my_grid[r][c].value = grid[r][c].value;
-            }
-            my_grid[row][col].value = num;
-            tids.push_back(thread(solve, my_grid, par_degree, tree_level+1));
+        if(!FindUnassignedMinimumLocation(grid, row, col)){
+            setSolution(grid);
+            return;
+        }
+        Mask mask = grid.candidates[row * N + col];
+        while(mask){
+            int num = __builtin_ctz(mask) + 1;
+            mask &= mask - 1;
+            Board my_grid = grid;
+            assign(my_grid, row, col, num);
+            pool->spawn(children, [my_grid, par_degree, tree_level]() { solve(my_grid, par_degree, tree_level+1); });
         }
-        for (std::thread &t : tids)
-            t.join();
+        pool->wait(children);
     }
     return;
 }
\ No newline at end of file
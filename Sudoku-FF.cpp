@@ -18,116 +18,221 @@
 /* The schemes emitted are selected from the initial schema, choosing the cell with  */
 /* less possible assignable values and enumerating them until a schema with that     */
 /* value assigned has been emitted for each value.                                   */
+/* The boards of the tasks come from per-thread slabs (slab.cpp) and are recycled,   */
+/* not freed, once explored.                                                         */
+/* Splitting stops where it does not pay off: a Worker explores the rest of the      */
+/* tree by itself, backtracking in place, once the schema has few empty cells left   */
+/* or when the Master already holds enough tasks waiting for a Worker, so that the   */
+/* farm is saturated and more tasks would only queue up in the Master.               */
 /*                                                                                   */
-/* Usage : <program_name> <nw> <board_index>                                         */
-/* Where nw=number of workers and board_index=which board you want to be resolved in */
-/* a [0-9] range taken from the "input.txt" file.                                    */
+/* Usage : <program_name> [-r rules] [-e engine] [-f input] [-c interval]            */
+/*                        [-t cutoff] [-q queued] [-k limit] [-a affinity]           */
+/*                        <nw> <board_index>                                         */
+/* Where nw=number of workers, board_index=which board you want to be resolved in    */
+/* a [0-9] range taken from the input file,                                          */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt). With dlx, every  */
+/* task is solved to completion by Dancing Links instead of being split further.     */
+/* interval=nodes explored by a thread between two checks of the cancellation flag   */
+/* raised by the first solution found (default 16).                                  */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* cutoff=number of empty cells under which a Worker does not split the schema any   */
+/* more (default N*N/4) and queued=number of tasks waiting in the Master over which  */
+/* the Workers stop sending new ones (default 4*nw).                                 */
+/* limit=how many solutions to count before stopping (0 for all of them), instead of */
+/* stopping at the first one; the number of solutions found is printed.              */
+/* affinity=placement of the threads on the cpus: compact (one NUMA node after the   */
+/* other), scatter (the nodes in turn), a list of cpus (e.g. 0-3,8) or none (the     */
+/* default, left to the scheduler); see affinity.cpp.                                */
+/* A placement given with -a replaces the default mapping of FastFlow, the Emitter   */
+/* going where a thread with id nw would.                                            */
 /*************************************************************************************/
 // #define PRINT_OVERHEAD = 1;
 // #define PRINT_SOLUTION = 1;
-// #define PRINT_TIMES = 1;
+// #define STATS = 1;
 
 #include "utils.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "slab.cpp"
+#include "search.cpp"
+#include "affinity.cpp"
 #include <ff/ff.hpp>
 
 using namespace ff;
 
-std::vector<Cell **> *solutions;
+// boards of the tasks, thread nw is the emitter
+slab<Board> *boards;
+
+std::vector<Board> *solutions;
 std::vector<bool> *sols_found;
 
 std::atomic_bool sol_found = false;
+CancelToken cancel_token;
+SolutionCounter counter;
+
+// tasks sent out by the emitter and not yet taken by a worker
+std::atomic_long queued(0);
+int cutoff = N * N / 4;
+long max_queued = -1;
 
 static inline void usage(const char *argv0);
 
 struct W : ff_node
 {
+    int svc_init()
+    {
+        pinThread(get_my_id());
+        // allocated and first written once the thread is pinned, so they are on its node
+        if (trail == nullptr)
+        {
+            trail = std::make_unique<Trail>();
+            stack = std::make_unique<SearchStack>();
+        }
+        return 0;
+    }
+
     void *svc(void *task)
     {
 #ifndef PRINT_OVERHEAD
-        Cell **grid = (Cell **)task;
-        std::vector<Cell **> *tasks = SolveSudoku(grid, get_my_id());
+        Board *grid = (Board *)task;
+        STAT_ADD(STAT_POPPED, 1);
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        if (cancel_token.cancelled())
+        {
+            boards->destroy(get_my_id(), grid);
+            return new std::vector<Board *>();
+        }
+        std::vector<Board *> *tasks = SolveSudoku(grid, get_my_id());
         return tasks;
 #else
-        return (new std::vector<Cell**>());
+        return (new std::vector<Board *>());
 #endif
     }
 
-    std::vector<Cell **> *SolveSudoku(Cell **grid, int tid)
+    std::vector<Board *> *SolveSudoku(Board *grid, int tid)
     {
-        std::vector<Cell **> *tasks = new std::vector<Cell **>();
+        std::vector<Board *> *tasks = new std::vector<Board *>();
         int row, col;
-        while (FindUnassignedMinimumLocation(grid, row, col))
+        while (true)
         {
-            int size = grid[row][col].possible_values.size();
-            if (size == 0)
+            STAT_ADD(STAT_NODES, 1);
+            if (cancel_token.poll(countdown))
+            {
+                // the branches found so far are useless now
+                for (Board *t : *tasks)
+                    boards->destroy(tid, t);
+                tasks->clear();
+                boards->destroy(tid, grid);
+                return tasks;
+            }
+            if (!propagate(*grid) || (engine == ENGINE_DLX && !solveDLX(*grid, &cancel_token, &counter)))
+            {
+                STAT_ADD(STAT_BACKTRACKS, 1);
+                boards->destroy(tid, grid);
+                return tasks;
+            }
+            if (!FindUnassignedMinimumLocation(*grid, row, col))
+                break;
+            Mask mask = grid->candidates[row * N + col];
+            if (mask == 0)
+            {
+                STAT_ADD(STAT_BACKTRACKS, 1);
+                boards->destroy(tid, grid);
+                return tasks;
+            }
+            if (engine == ENGINE_BT && (countEmpty(*grid) <= cutoff ||
+                                        queued.load(std::memory_order_relaxed) >= max_queued))
+            {
+                trail->size = 0;
+                SolveLocally(*grid, *trail, tid);
+                boards->destroy(tid, grid);
                 return tasks;
-            for (int i = 1; i < size; i++)
+            }
+            int first = __builtin_ctz(mask) + 1;
+            mask &= mask - 1;
+            while (mask)
             {
-                Cell **new_grid;
-                copyCell(grid, new_grid);
-                new_grid[row][col].value = grid[row][col].possible_values[i];
-                calculatePossibleValues(new_grid);
+                Board *new_grid = boards->create(tid, *grid);
+                assign(*new_grid, row, col, __builtin_ctz(mask) + 1);
                 tasks->push_back(new_grid);
+                STAT_ADD(STAT_PUSHED, 1);
+                mask &= mask - 1;
             }
-            grid[row][col].value = grid[row][col].possible_values[0];
-            calculatePossibleValues(grid);
+            assign(*grid, row, col, first);
         }
-        setSolution(grid, tid);
-        free(grid);
+        setSolution(*grid, tid, engine == ENGINE_DLX);
+        boards->destroy(tid, grid);
         return tasks;
     }
 
-    void setSolution(Cell **my_sol, int tid)
+    std::unique_ptr<Trail> trail;
+
+    std::unique_ptr<SearchStack> stack;
+
+    // nodes of this worker until the cancellation flag is read again
+    int countdown = 0;
+
+    // sequential backtracking on the board, undoing the assignments through the trail
+    bool SolveLocally(Board &grid, Trail &trail, int tid)
     {
+        return search(grid, trail, *stack, [&](const Board &solution) { return setSolution(solution, tid); },
+                      [this] { return cancel_token.poll(countdown); });
+    }
+
+    // false if the solutions are being counted and the search goes on; counted if
+    // solveDLX has already recorded the solution in the counter
+    bool setSolution(const Board &my_sol, int tid, bool counted = false)
+    {
+        if (counter.counting() && !counted && !counter.found())
+            return false;
         sol_found = true;
+        cancel_token.cancel();
 #ifdef PRINT_SOLUTION
-        for (int i = 0; i < N; i++)
-            for (int j = 0; j < N; j++)
-                (*solutions)[tid][i][j].value = my_sol[i][j].value;
+        (*solutions)[tid] = my_sol;
 
         (*sols_found)[tid] = true;
 #endif
+        return true;
     }
 
 };
 
-class E : public ff_node_t<std::vector<Cell **>, long>
+class E : public ff_node_t<std::vector<Board *>, long>
 {
 public:
-    E(Cell **grid) : grid(grid) {}
-    long *svc(std::vector<Cell **> *task)
+    E(Board &grid, int nworkers) : grid(grid), nworkers(nworkers) {}
+    int svc_init()
+    {
+        pinThread(nworkers);
+        return 0;
+    }
+
+    long *svc(std::vector<Board *> *task)
     {
-#ifdef PRINT_TIMES
-        auto start = chrono::high_resolution_clock::now();
-#endif
         if (task == nullptr)
         {
-
+            STAT_START(master);
             EmitTasks();
-#ifdef PRINT_TIMES
-        elapsed += chrono::high_resolution_clock::now() - start;
-#endif
+            STAT_STOP(STAT_MASTER, master);
+            if (numtasks == 0)
+                return EOS;
             return GO_ON;
         }
 #ifndef PRINT_OVERHEAD
-        for (Cell **c : *task)
+        STAT_START(forward);
+        for (Board *c : *task)
         {
+            queued.fetch_add(1, std::memory_order_relaxed);
             ff_send_out(c);
             numtasks++;
         }
-        free(task);
+        delete task;
+        STAT_STOP(STAT_EMITTER, forward);
 
-        if (--numtasks == 0 || sol_found){
-#ifdef PRINT_TIMES
-            elapsed += chrono::high_resolution_clock::now() - start;
-            auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
-            cout << "Master took : " << usec << " usecs." << endl;
-#endif
+        if (--numtasks == 0 || sol_found)
             return EOS;
-        }
-#ifdef PRINT_TIMES
-        elapsed += chrono::high_resolution_clock::now() - start;
-#endif
         return GO_ON;
 #else
         return EOS;
@@ -136,65 +241,105 @@ public:
 
     void EmitTasks()
     {
-        RemoveSingletons(grid);
         int row, col;
-        FindUnassignedMinimumLocation(grid, row, col);
+        if (!propagate(grid))
+            return;
+        if (!FindUnassignedMinimumLocation(grid, row, col))
+        {
+            if (counter.counting() && !counter.found())
+                return;
+            sol_found = true;
+#ifdef PRINT_SOLUTION
+            (*solutions)[0] = grid;
+            (*sols_found)[0] = true;
+#endif
+            return;
+        }
         for (int j = 1; j <= N; j++)
         {
-            if (isSafe(grid, row, col, j))
+            if (grid.candidates[row * N + col] & DIGIT_BIT(j))
             {
-                Cell **my_grid = new Cell *[N];
-                for (int r = 0; r < N; r++)
-                {
-                    my_grid[r] = new Cell[N];
-                    for (int c = 0; c < N; c++)
-                        if (grid[r][c].value == WORKING_ON)
-                            my_grid[r][c].value = 0;
-                        else
-                            my_grid[r][c].value = grid[r][c].value;
-                }
-                my_grid[row][col].value = j;
-                calculatePossibleValues(my_grid);
+                Board *my_grid = boards->create(nworkers, grid);
+                assign(*my_grid, row, col, j);
+                queued.fetch_add(1, std::memory_order_relaxed);
                 ff_send_out(my_grid);
+                STAT_ADD(STAT_PUSHED, 1);
                 numtasks++;
             }
         }
     }
 
 private:
-    Cell **grid;
+    Board grid;
+    int nworkers;
     long numtasks = 0;
-    long num_times = 0;
-    std::chrono::nanoseconds elapsed = std::chrono::nanoseconds(0);
 };
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    int opt;
+    string input = "input.txt";
+    while ((opt = getopt(argc, argv, "r:e:f:c:t:q:k:a:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'c':
+            if ((cancel_token.interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 't':
+            if ((cutoff = atoi(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'q':
+            if ((max_queued = atol(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'k':
+            if ((counter.limit = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'a':
+            if (!parseAffinity(optarg))
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 2)
         usage(argv[0]);
 
-    std::vector<int **> *grids = new std::vector<int **>();
-    readGrids(grids, "input.txt");
-
-    int nw = atoi(argv[1]);
-    int board_index = atoi(argv[2]);
+    int nw = atoi(argv[optind]);
+    int board_index = atoi(argv[optind + 1]);
+    if (max_queued < 0)
+        max_queued = 4 * nw;
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, board_index))
+        usage(argv[0]);
 
-    solutions = new std::vector<Cell **>(nw);
+    boards = new slab<Board>(nw + 1);
+    solutions = new std::vector<Board>(nw);
     sols_found = new std::vector<bool>(nw);
 
     for (int i = 0; i < nw; i++)
-    {
-        (*solutions)[i] = new Cell *[N];
-        for (int j = 0; j < N; j++)
-            (*solutions)[i][j] = new Cell[N];
         sols_found->at(i) = false;
-    }
-    Cell **filledGrid = fillGrid((*grids)[board_index]);
+    Board filledGrid = fillGrid(puzzle);
+    counter.token = &cancel_token;
 
-    E emitter(filledGrid);
+    E emitter(filledGrid, nw);
 
     std::vector<std::unique_ptr<ff_node>> workers;
-    for (size_t i = 0; i < nw; i++)
+    for (int i = 0; i < nw; i++)
         workers.push_back(make_unique<W>());
 
     ff_Farm<void> farm(std::move(workers), emitter);
@@ -220,18 +365,22 @@ int main(int argc, char *argv[])
                 break;
             }
     }
-    else
+    else if (!counter.counting())
         std::cout << "No solution exists\n";
 #endif
 
     cout << "Execution took : " << usec_farm << " usecs." << endl;
+    if (counter.counting())
+        cout << "Solutions : " << counter.total() << endl;
+    printStats();
     return 0;
 }
 
 static inline void usage(const char *argv0)
 {
     printf("--------------------\n");
-    printf("Usage: %s <n_workers> <board_index>\n", argv0);
+    printf("Usage: %s [-r rules] [-e engine] [-f input] [-c interval] [-t cutoff] [-q queued]\n", argv0);
+    printf("          [-k limit] [-a affinity] <n_workers> <board_index>\n");
     printf("--------------------\n");
     exit(-1);
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program solves every Sudoku schema of a file, using standard C++ threads.    */
+/* The parallelism is among the schemas: every thread takes the next chunk of        */
+/* schemas not yet taken, decoding them from the file mapped in memory (see          */
+/* PuzzleReader) that is never loaded whole, and solves each one of them with the    */
+/* sequential kernel of Sudoku-seq-BF, so no synchronization is needed inside a      */
+/* resolution.                                                                       */
+/* The solutions are written in the output file in the same order of the schemas     */
+/* in the input file, one per line (a line "No solution exists" for a schema that    */
+/* has none), as soon as the ones before them are: a schema solved early waits in a  */
+/* reorder window of fixed size, and no thread takes a schema that would not fit in  */
+/* it, so the memory used does not depend on the number of schemas. At the end the   */
+/* program prints the number of schemas solved per second and the percentiles of the */
+/* time taken by a single schema, kept in a histogram of fixed size.                 */
+/* A line of the input that is not a schema stops the reading: the schemas before it */
+/* are still solved and written, then the program reports the line and fails.        */
+/* With a cache, every schema is first put in its canonical form (cache.cpp), and    */
+/* only the canonical forms never seen before are solved: the others take the        */
+/* solution found for the first one, mapped back to their own rows, columns and      */
+/* digits.                                                                           */
+/*                                                                                   */
+/* Usage : <program_name> [-r rules] [-e engine] [-o output] [-m entries] <nw>       */
+/*                        [input]                                                    */
+/* Where nw=number of workers, input=file with one schema per line (default          */
+/* "input.txt"), output=file where the solutions are written, in the same format     */
+/* (default "output.txt"),                                                           */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt).                  */
+/* entries=how many solutions the cache keeps (default 0, no cache).                 */
+/*************************************************************************************/
+
+#include "utils.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
+#include "cache.cpp"
+#include "histogram.cpp"
+#include <algorithm>
+#include <condition_variable>
+using namespace std;
+
+// schemas taken at once by a thread
+#define CHUNK 16
+// schemas solved and waiting for the ones before them to be written, at least
+#define WINDOW 4096
+
+/* A schema of the reorder window: done once solved, until it is written */
+struct Slot
+{
+    Puzzle solution;
+    bool solved;
+    bool done = false;
+    long latency;
+};
+
+// the input, decoded a chunk at a time as the threads take the schemas
+PuzzleReader *reader;
+
+// the reorder window, schema i in slot i % its size, and what follows under window_mutex
+vector<Slot> *window;
+mutex window_mutex;
+condition_variable window_condition;
+bool exhausted = false;
+string malformed;
+long next_grid = 0;
+long written = 0;
+long n_solved = 0;
+LatencyHistogram latencies;
+ofstream out;
+
+solution_cache<BOX_SIZE> *cache = nullptr;
+
+bool solve(Board &grid, Trail &trail);
+long takeSchemas(Puzzle *chunk, long &first);
+void complete(long i, const Slot &slot);
+void threadBody();
+void writeGrid(ofstream &out, const Puzzle &grid);
+static inline void usage(const char *argv0);
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    string output = "output.txt";
+    long entries = 0;
+    while ((opt = getopt(argc, argv, "r:e:o:m:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'm':
+            if ((entries = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 1 && argc - optind != 2)
+        usage(argv[0]);
+
+    int nw = atoi(argv[optind]);
+    if (nw <= 0)
+        usage(argv[0]);
+
+    string input = argc - optind == 2 ? argv[optind + 1] : "input.txt";
+    reader = new PuzzleReader(input);
+
+    if (entries > 0)
+        cache = new solution_cache<BOX_SIZE>(entries);
+    // every thread can have a chunk in flight while the window waits for the oldest one
+    window = new vector<Slot>(max(WINDOW, 2 * nw * CHUNK));
+    out.open(output);
+
+    vector<thread *> threadPool;
+    auto start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < nw; i++)
+        threadPool.push_back(new std::thread(threadBody));
+    for (thread *t : threadPool)
+        t->join();
+    auto elapsed = chrono::high_resolution_clock::now() - start;
+    auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+    out.close();
+    if (!malformed.empty())
+    {
+        cout << "Malformed schema at " << malformed << " of " << input << ", " << written
+             << " schemas before it solved" << endl;
+        return -1;
+    }
+
+    long n = written;
+    auto percentile = [n](double p) { return n == 0 ? 0 : latencies.percentile(p); };
+
+    cout << "Execution took : " << usec << " usecs." << endl;
+    cout << "Puzzles : " << n << " (" << n_solved << " solved)" << endl;
+    cout << "Throughput : " << (usec == 0 ? 0 : n * 1000000.0 / usec) << " puzzles/sec" << endl;
+    cout << "Latency p50 : " << percentile(0.50) << " usecs." << endl;
+    cout << "Latency p90 : " << percentile(0.90) << " usecs." << endl;
+    cout << "Latency p99 : " << percentile(0.99) << " usecs." << endl;
+    cout << "Latency max : " << latencies.max << " usecs." << endl;
+    if (cache != nullptr)
+        cout << "Cache hits : " << cache->hits() << " of " << n << " ("
+             << (n == 0 ? 0 : cache->hits() * 100.0 / n) << "%)" << endl;
+    printStats();
+    return 0;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-r rules] [-e engine] [-o output] [-m entries] <n_workers> [input]\n", argv0);
+    printf("--------------------\n");
+    exit(-1);
+}
+
+void writeGrid(ofstream &out, const Puzzle &grid)
+{
+    for (int i = 0; i < N * N; i++)
+        out << (int)grid.value[i] << " ";
+    out << "\n";
+}
+
+/* Reads into chunk the next schemas, as many as CHUNK and the window allow, */
+/* waiting for the window to have room; their number, 0 at the end or at    */
+/* the first malformed schema.                                               */
+long takeSchemas(Puzzle *chunk, long &first)
+{
+    std::unique_lock<std::mutex> lock(window_mutex);
+    long size = window->size();
+    while (!exhausted && next_grid == written + size)
+        window_condition.wait(lock);
+    first = next_grid;
+    long count = 0, room = min((long)CHUNK, written + size - first);
+    while (!exhausted && count < room)
+    {
+        ReadResult result = reader->next(chunk[count]);
+        if (result == READ_BOARD)
+            count++;
+        else
+            exhausted = true;
+        if (result == READ_NO_SOLUTION || result == READ_MALFORMED)
+            malformed = reader->where();
+    }
+    next_grid += count;
+    return count;
+}
+
+/* Puts schema i in the window and writes the schemas that are ready, in order */
+void complete(long i, const Slot &slot)
+{
+    std::unique_lock<std::mutex> lock(window_mutex);
+    long size = window->size();
+    (*window)[i % size] = slot;
+    (*window)[i % size].done = true;
+    if (i != written)
+        return;
+    for (Slot *s; (s = &(*window)[written % size])->done; written++)
+    {
+        if (s->solved)
+            writeGrid(out, s->solution);
+        else
+            out << NO_SOLUTION_LINE "\n";
+        n_solved += s->solved;
+        latencies.add(s->latency);
+        s->done = false;
+    }
+    window_condition.notify_all();
+}
+
+void threadBody()
+{
+    Trail *trail = new Trail();
+    Puzzle *chunk = new Puzzle[CHUNK];
+    long first, count;
+    while ((count = takeSchemas(chunk, first)) > 0)
+        for (long i = 0; i < count; i++)
+        {
+            auto start = chrono::high_resolution_clock::now();
+            const Puzzle *puzzle = &chunk[i];
+            Canonical canonical;
+            Puzzle solution;
+            Slot slot;
+            bool result, cached = false;
+            if (cache != nullptr)
+            {
+                // the canonical form is solved instead, its solution is what the cache keeps
+                canonicalize(*puzzle, canonical);
+                puzzle = &canonical.puzzle;
+                cached = cache->lookup(canonical.puzzle, result, solution);
+            }
+            if (!cached)
+            {
+                Board grid = fillGrid(*puzzle);
+                trail->size = 0;
+                result = propagate(grid, trail) &&
+                         (engine == ENGINE_DLX ? solveDLX(grid) : solve(grid, *trail));
+                memcpy(solution.value, grid.value, sizeof(solution.value));
+                if (cache != nullptr)
+                    cache->insert(canonical.puzzle, result, solution);
+            }
+            if (result && cache != nullptr)
+                fromCanonical(canonical, solution, slot.solution);
+            else if (result)
+                slot.solution = solution;
+            auto elapsed = chrono::high_resolution_clock::now() - start;
+            slot.latency = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+            slot.solved = result;
+            complete(first + i, slot);
+        }
+    delete[] chunk;
+    delete trail;
+}
+
+bool solve(Board &grid, Trail &trail)
+{
+    SearchStack stack;
+    return search(grid, trail, stack, [](const Board &) { return true; }, [] { return false; });
+}
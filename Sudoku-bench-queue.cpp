@@ -0,0 +1,144 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program measures the queues of queue.cpp under contention: the one with a    */
+/* lock (syque) and the lock-free bounded one (mpmcque). Producers push a number of  */
+/* values, alone or in batches with push_many, while consumers pop them until every  */
+/* value has been taken; the sum of the values popped is checked against the one of  */
+/* the values pushed. The time is the one from the start of the threads to the last  */
+/* pop, and the rate counts a push and its pop as one operation.                     */
+/*                                                                                   */
+/* Usage : <program_name> [-p producers] [-c consumers] [-n operations] [-b batch]   */
+/*                        [-s capacity]                                              */
+/* Where producers and consumers=number of threads pushing and popping (default 4    */
+/* each), operations=values pushed by all the producers together (default 10^7),     */
+/* batch=values pushed at once (default 1) and capacity=slots of mpmcque (default    */
+/* 65536).                                                                           */
+/*************************************************************************************/
+
+#include "utils.cpp"
+#include "queue.cpp"
+using namespace std;
+
+static inline void usage(const char *argv0);
+
+int producers = 4, consumers = 4, batch = 1;
+long operations = 10000000;
+
+// values pushed by a producer in batches; the ones that do not fit are pushed alone
+template <typename Q>
+void produce(Q &queue, long from, long to)
+{
+    vector<long> values(batch);
+    for (long v = from; v < to; v += batch)
+    {
+        long k = min((long)batch, to - v);
+        if (k == 1)
+        {
+            queue.push(v);
+            continue;
+        }
+        for (long i = 0; i < k; i++)
+            values[i] = v + i;
+        for (long i = queue.push_many(values.begin(), values.begin() + k); i < k; i++)
+            queue.push(values[i]);
+    }
+}
+
+// every consumer stops at the first -1, pushed once all the values are
+template <typename Q>
+double run(Q &queue, long &sum)
+{
+    atomic_long total(0);
+    vector<thread> threads;
+    auto start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < consumers; i++)
+        threads.push_back(thread([&] {
+            long local = 0;
+            for (long v; (v = queue.pop()) >= 0;)
+                local += v;
+            total += local;
+        }));
+    vector<thread> pushers;
+    for (int i = 0; i < producers; i++)
+        pushers.push_back(thread(produce<Q>, ref(queue), operations * i / producers, operations * (i + 1) / producers));
+    for (thread &t : pushers)
+        t.join();
+    for (int i = 0; i < consumers; i++)
+        queue.push(-1);
+    for (thread &t : threads)
+        t.join();
+    sum = total;
+    return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+template <typename Q>
+void measure(const char *name, Q &queue)
+{
+    long sum;
+    double secs = run(queue, sum);
+    if (sum != operations * (operations - 1) / 2)
+    {
+        cout << name << " lost values" << endl;
+        exit(-1);
+    }
+    cout << name << " : " << (long)(operations / secs) << " ops/sec (" << secs * 1e6 << " usecs)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    long capacity = 65536;
+    while ((opt = getopt(argc, argv, "p:c:n:b:s:")) != -1)
+        switch (opt)
+        {
+        case 'p':
+            if ((producers = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'c':
+            if ((consumers = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'n':
+            if ((operations = atol(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'b':
+            if ((batch = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 's':
+            if ((capacity = atol(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 0)
+        usage(argv[0]);
+
+    cout << producers << " producers, " << consumers << " consumers, batches of " << batch << endl;
+    {
+        syque<long> queue;
+        measure("syque", queue);
+    }
+    {
+        mpmcque<long> queue(capacity);
+        measure("mpmcque", queue);
+    }
+    return 0;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-p producers] [-c consumers] [-n operations] [-b batch] [-s capacity]\n", argv0);
+    printf("--------------------\n");
+    exit(-1);
+}
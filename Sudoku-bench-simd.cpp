@@ -0,0 +1,125 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program measures the kernels that compute the candidates of every cell and   */
+/* find the cell with the fewest candidates (FindUnassignedMinimumLocation), in      */
+/* their scalar version and in every vectorized version the processor supports.      */
+/* Every schema of the input file is taken both as it is read and after the          */
+/* propagation of the rules, and the result of every version is checked against the  */
+/* scalar one before timing it.                                                      */
+/*                                                                                   */
+/* Usage : <program_name> [-f input] [-n repetitions]                                */
+/* Where input=file the boards are read from, text or binary (default "input.txt")   */
+/* and repetitions=how many times every kernel runs over all the boards (default     */
+/* 10000).                                                                           */
+/*************************************************************************************/
+
+#include "utils.cpp"
+#include "propagation.cpp"
+using namespace std;
+
+static inline void usage(const char *argv0);
+
+const char *level_names[] = {"scalar", "sse4.1", "avx2"};
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    string input = "input.txt";
+    long repetitions = 10000;
+    while ((opt = getopt(argc, argv, "f:n:")) != -1)
+        switch (opt)
+        {
+        case 'f':
+            input = optarg;
+            break;
+        case 'n':
+            if ((repetitions = atol(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 0)
+        usage(argv[0]);
+
+    vector<Puzzle> puzzles;
+    if (!readGrids(puzzles, input))
+        return -1;
+    vector<Board> grids;
+    for (Puzzle &p : puzzles)
+    {
+        Board grid = fillGrid(p);
+        grids.push_back(grid);
+        if (propagate(grid))
+            grids.push_back(grid);
+    }
+    if (grids.empty())
+        usage(argv[0]);
+
+    // 25x25 boards have 32 bit masks, with no vectorized kernels
+    int max_level = sizeof(Mask) == 2 ? simd_level : SIMD_NONE;
+    double scalar_mrv = 0, scalar_candidates = 0;
+    long sink = 0;
+    for (int level = SIMD_NONE; level <= max_level; level++)
+    {
+        simd_level = level;
+        for (Board &grid : grids)
+        {
+            int row = -1, col = -1, srow = -1, scol = -1;
+            Board copy = grid;
+            calculatePossibleValues(copy);
+            Board reference = grid;
+            calculatePossibleValuesScalar(reference);
+            if (FindUnassignedMinimumLocation(grid, row, col) != FindUnassignedMinimumLocationScalar(grid, srow, scol) ||
+                row != srow || col != scol || memcmp(copy.candidates, reference.candidates, sizeof(copy.candidates)) != 0)
+            {
+                cout << level_names[level] << " kernels differ from the scalar ones" << endl;
+                return -1;
+            }
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        for (long r = 0; r < repetitions; r++)
+            for (Board &grid : grids)
+            {
+                int row = 0, col = 0;
+                FindUnassignedMinimumLocation(grid, row, col);
+                sink += row + col;
+            }
+        double mrv = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start).count() / (repetitions * grids.size());
+
+        start = chrono::high_resolution_clock::now();
+        for (long r = 0; r < repetitions; r++)
+            for (Board &grid : grids)
+            {
+                calculatePossibleValues(grid);
+                sink += grid.candidates[r % (N * N)];
+            }
+        double candidates = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start).count() / (repetitions * grids.size());
+
+        if (level == SIMD_NONE)
+        {
+            scalar_mrv = mrv;
+            scalar_candidates = candidates;
+        }
+        cout << "MRV " << level_names[level] << " : " << mrv << " nsecs per board (speedup " << scalar_mrv / mrv << ")" << endl;
+        cout << "Candidates " << level_names[level] << " : " << candidates << " nsecs per board (speedup " << scalar_candidates / candidates << ")" << endl;
+    }
+    if (sink == 42)
+        cout << endl;
+    return 0;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-f input] [-n repetitions]\n", argv0);
+    printf("--------------------\n");
+    exit(-1);
+}
@@ -0,0 +1,312 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program benchmarks the other programs of the project over a set of boards.   */
+/* Every program is run on every board, for every number of workers and, for         */
+/* Sudoku-DC, every depth of the tree requested, first some times to warm up and     */
+/* then for the measured trials, reading the "Execution took" line it prints (and    */
+/* the "Search nodes" line, if any: without -DSTATS only Sudoku-seq-BF prints it, so */
+/* make bench builds all the programs with -DSTATS before running this one).         */
+/* For every configuration and board it writes the median and 95th percentile of     */
+/* the times, the speedup and efficiency with respect to the median time of          */
+/* Sudoku-seq-BF on the same board and the nodes explored per second, as CSV (one    */
+/* line per configuration and board) or as a JSON array.                             */
+/*                                                                                   */
+/* Usage : <program_name> [-d dir] [-f input] [-b boards] [-s solvers] [-w nws]      */
+/*                        [-p par_degrees] [-t trials] [-u warmup] [-r rules]        */
+/*                        [-e engine] [-a affinity]... [-j]                          */
+/* Where dir=directory of the programs (default "./build"), input=file the boards    */
+/* are read from (default "input.txt"), boards=list of the boards (default all),     */
+/* solvers=list of the programs among seq, dc, ff, queue, ws and donation (default   */
+/* all), nws=list of the numbers of workers (default 1,2,4), par_degrees=list of     */
+/* the depths for Sudoku-DC (default 1,2,3), trials=measured runs (default 5),       */
+/* warmup=runs not measured (default 1), rules and engine are passed to every        */
+/* program and -j writes JSON instead of CSV. A list is made of numbers and ranges   */
+/* separated by commas, e.g. 0-4,7.                                                  */
+/* Every -a adds a placement of the threads (compact, scatter, a list of cpus or     */
+/* none, see affinity.cpp) every parallel program is run with, so that the effect    */
+/* of keeping the threads and their boards on one NUMA node or spreading them shows  */
+/* in the results side by side; by default the threads are not pinned.               */
+/*************************************************************************************/
+
+#include "utils.cpp"
+#include <algorithm>
+#include <sstream>
+#include <tuple>
+using namespace std;
+
+struct Solver
+{
+    string name;
+    string program;
+    bool parallel;
+};
+
+const vector<Solver> all_solvers = {
+    {"seq", "Sudoku-seq-BF", false},
+    {"dc", "Sudoku-DC", true},
+    {"ff", "Sudoku-FF", true},
+    {"queue", "Sudoku-single-queue", true},
+    {"ws", "Sudoku-work-stealing", true},
+    {"donation", "Sudoku-donation", true},
+};
+
+struct Result
+{
+    string solver;
+    int nw;
+    int par_degree;
+    string affinity;
+    long board;
+    double median, p95;
+    double speedup;
+    long nodes;
+};
+
+static inline void usage(const char *argv0);
+bool parseList(const char *list, vector<long> &values);
+bool run(const string &command, long &usec, long &nodes);
+void printResults(const vector<Result> &results, bool json);
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    string dir = "./build", input = "input.txt", options;
+    vector<long> boards, nws = {1, 2, 4}, par_degrees = {1, 2, 3};
+    vector<Solver> solvers = all_solvers;
+    vector<string> affinities;
+    int trials = 5, warmup = 1;
+    bool json = false;
+    while ((opt = getopt(argc, argv, "d:f:b:s:w:p:t:u:r:e:a:j")) != -1)
+        switch (opt)
+        {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'b':
+            if (!parseList(optarg, boards))
+                usage(argv[0]);
+            break;
+        case 's':
+        {
+            // kept in the order of all_solvers, so seq runs first and gives the speedups
+            vector<string> names;
+            stringstream list(optarg);
+            string name;
+            while (getline(list, name, ','))
+            {
+                if (none_of(all_solvers.begin(), all_solvers.end(), [&](const Solver &s) { return s.name == name; }))
+                    usage(argv[0]);
+                names.push_back(name);
+            }
+            solvers.clear();
+            for (const Solver &s : all_solvers)
+                if (find(names.begin(), names.end(), s.name) != names.end())
+                    solvers.push_back(s);
+            break;
+        }
+        case 'w':
+            if (!parseList(optarg, nws))
+                usage(argv[0]);
+            break;
+        case 'p':
+            if (!parseList(optarg, par_degrees))
+                usage(argv[0]);
+            break;
+        case 't':
+            if ((trials = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'u':
+            if ((warmup = atoi(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'r':
+            options += string(" -r ") + optarg;
+            break;
+        case 'e':
+            options += string(" -e ") + optarg;
+            break;
+        case 'a':
+            affinities.push_back(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 0)
+        usage(argv[0]);
+
+    if (boards.empty())
+    {
+        vector<Puzzle> puzzles;
+        if (!readGrids(puzzles, input))
+            return -1;
+        for (long i = 0; i < (long)puzzles.size(); i++)
+            boards.push_back(i);
+    }
+    options += " -f " + input;
+    if (affinities.empty())
+        affinities.push_back("none");
+
+    vector<Solver> available;
+    for (const Solver &solver : solvers)
+        if (access((dir + "/" + solver.program).c_str(), X_OK) == 0)
+            available.push_back(solver);
+        else
+            cerr << "Skipping " << dir << "/" << solver.program << ": not found" << endl;
+
+    vector<Result> results;
+    for (long board : boards)
+    {
+        double seq_median = 0;
+        for (const Solver &solver : available)
+        {
+            string program = dir + "/" + solver.program;
+            // one configuration per number of workers, placement and, for DC, depth of the tree
+            vector<tuple<int, int, string>> configurations;
+            if (!solver.parallel)
+                configurations.push_back(make_tuple(1, -1, "none"));
+            else
+                for (long nw : nws)
+                    for (const string &affinity : affinities)
+                        if (solver.name == "dc")
+                            for (long par_degree : par_degrees)
+                                configurations.push_back(make_tuple(nw, par_degree, affinity));
+                        else
+                            configurations.push_back(make_tuple(nw, -1, affinity));
+
+            for (auto &configuration : configurations)
+            {
+                int nw = get<0>(configuration), par_degree = get<1>(configuration);
+                const string &affinity = get<2>(configuration);
+                string command = program + options;
+                if (solver.parallel)
+                    command += " -a " + affinity;
+                if (solver.name == "dc")
+                    command += " -w " + to_string(nw) + " " + to_string(par_degree);
+                else if (solver.parallel)
+                    command += " " + to_string(nw);
+                command += " " + to_string(board);
+
+                vector<double> times;
+                long usec, nodes = -1;
+                bool failed = false;
+                for (int t = 0; t < warmup + trials && !failed; t++)
+                {
+                    failed = !run(command, usec, nodes);
+                    if (t >= warmup)
+                        times.push_back(usec);
+                }
+                if (failed)
+                {
+                    cerr << "Failed: " << command << endl;
+                    continue;
+                }
+                sort(times.begin(), times.end());
+                Result r;
+                r.solver = solver.name;
+                r.nw = nw;
+                r.par_degree = par_degree;
+                r.affinity = affinity;
+                r.board = board;
+                r.median = times.size() % 2 ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+                r.p95 = times[min(times.size() - 1, (size_t)(0.95 * times.size()))];
+                if (!solver.parallel)
+                    seq_median = r.median;
+                r.speedup = seq_median > 0 && r.median > 0 ? seq_median / r.median : -1;
+                r.nodes = nodes;
+                results.push_back(r);
+            }
+        }
+    }
+    printResults(results, json);
+    return 0;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-d dir] [-f input] [-b boards] [-s solvers] [-w nws] [-p par_degrees]\n", argv0);
+    printf("          [-t trials] [-u warmup] [-r rules] [-e engine] [-a affinity]... [-j]\n");
+    printf("The node rates of the parallel programs need them built with -DSTATS (make bench)\n");
+    printf("--------------------\n");
+    exit(-1);
+}
+
+bool parseList(const char *list, vector<long> &values)
+{
+    values.clear();
+    stringstream items(list);
+    string item;
+    while (getline(items, item, ','))
+    {
+        long first, last;
+        char dash;
+        stringstream range(item);
+        if (!(range >> first) || first < 0)
+            return false;
+        last = first;
+        if (range >> dash && (dash != '-' || !(range >> last) || last < first))
+            return false;
+        for (long v = first; v <= last; v++)
+            values.push_back(v);
+    }
+    return !values.empty();
+}
+
+// runs the command once, false if it did not print its execution time
+bool run(const string &command, long &usec, long &nodes)
+{
+    FILE *out = popen(command.c_str(), "r");
+    if (out == nullptr)
+        return false;
+    char line[256];
+    bool timed = false;
+    while (fgets(line, sizeof(line), out) != nullptr)
+    {
+        if (sscanf(line, "Execution took : %ld usecs.", &usec) == 1)
+            timed = true;
+        sscanf(line, "Search nodes : %ld", &nodes);
+    }
+    return pclose(out) == 0 && timed;
+}
+
+void printResults(const vector<Result> &results, bool json)
+{
+    if (json)
+        cout << "[" << endl;
+    else
+        cout << "solver,nw,par_degree,affinity,board,median_usecs,p95_usecs,speedup,efficiency,nodes,nodes_per_sec" << endl;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        // empty fields in CSV and null in JSON when a value is not known
+        string none = json ? "null" : "";
+        string par_degree = r.par_degree < 0 ? none : to_string(r.par_degree);
+        string speedup = r.speedup < 0 ? none : to_string(r.speedup);
+        string efficiency = r.speedup < 0 ? none : to_string(r.speedup / r.nw);
+        string nodes = r.nodes < 0 ? none : to_string(r.nodes);
+        string nodes_per_sec = r.nodes < 0 || r.median <= 0 ? none : to_string(r.nodes * 1e6 / r.median);
+        if (json)
+            cout << "  {\"solver\": \"" << r.solver << "\", \"nw\": " << r.nw << ", \"par_degree\": " << par_degree
+                 << ", \"affinity\": \"" << r.affinity << "\", \"board\": " << r.board << ", \"median_usecs\": " << r.median << ", \"p95_usecs\": " << r.p95
+                 << ", \"speedup\": " << speedup << ", \"efficiency\": " << efficiency << ", \"nodes\": " << nodes
+                 << ", \"nodes_per_sec\": " << nodes_per_sec << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        else
+            cout << r.solver << "," << r.nw << "," << par_degree << "," << r.affinity << "," << r.board << "," << r.median << "," << r.p95 << ","
+                 << speedup << "," << efficiency << "," << nodes << "," << nodes_per_sec << endl;
+    }
+    if (json)
+        cout << "]" << endl;
+}
@@ -0,0 +1,128 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program converts a file of Sudoku schemas in the binary format read by all   */
+/* the other programs (see PuzzleFileHeader in utils.cpp), so that they load the     */
+/* requested schema in constant time instead of parsing the whole text file.         */
+/* The solutions of the schemas, e.g. the output of Sudoku-batch, can be stored in   */
+/* the same file. The input can also be a binary file, to convert it back to text.   */
+/*                                                                                   */
+/* Usage : <program_name> [-s solutions] [-t] <input> <output>                       */
+/* Where input=file with one schema per line or binary file, output=binary file      */
+/* written, solutions=file with the solutions of the schemas of input, in the same   */
+/* order, stored along with them (the line "No solution exists" Sudoku-batch writes  */
+/* for a schema with no solution) and -t writes output as text, one schema per line. */
+/* If a schema or a solution is malformed or missing, or a binary input holds boards */
+/* of another size than the one the program is compiled for, the program reports it  */
+/* and fails without leaving any output file.                                        */
+/*************************************************************************************/
+
+#include "utils.cpp"
+using namespace std;
+
+static inline void usage(const char *argv0);
+static bool sameSize(const PuzzleReader &reader, const char *filename);
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    const char *solutions_file = nullptr;
+    bool text = false;
+    while ((opt = getopt(argc, argv, "s:t")) != -1)
+        switch (opt)
+        {
+        case 's':
+            solutions_file = optarg;
+            break;
+        case 't':
+            text = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 2 || (text && solutions_file != nullptr))
+        usage(argv[0]);
+
+    const char *output = argv[optind + 1];
+    PuzzleReader reader(argv[optind]);
+    PuzzleReader *solutions = solutions_file == nullptr ? nullptr : new PuzzleReader(solutions_file);
+    Puzzle puzzle, solution;
+    ReadResult result;
+    string error;
+    long count = 0;
+    // the boards of a binary file of another size are not read at all
+    if (!sameSize(reader, argv[optind]) || (solutions != nullptr && !sameSize(*solutions, solutions_file)))
+        return -1;
+
+    auto start = chrono::high_resolution_clock::now();
+    if (text)
+    {
+        ofstream out(output);
+        while ((result = reader.next(puzzle)) == READ_BOARD)
+        {
+            for (int i = 0; i < N * N; i++)
+                out << (int)puzzle.value[i] << " ";
+            out << "\n";
+            count++;
+        }
+    }
+    else
+    {
+        PuzzleWriter writer(output, BOX_SIZE, solutions != nullptr);
+        if (!writer.isOpen())
+            usage(argv[0]);
+        while ((result = reader.next(puzzle)) == READ_BOARD)
+        {
+            // a schema with no solution keeps the empty one next() leaves
+            ReadResult found = solutions == nullptr ? READ_NO_SOLUTION : solutions->next(solution);
+            if (found == READ_END)
+                error = "Missing solution of schema " + to_string(count);
+            else if (found == READ_MALFORMED)
+                error = "Malformed solution at " + solutions->where() + " of " + solutions_file;
+            if (!error.empty())
+                break;
+            writer.write(puzzle, &solution);
+            count++;
+        }
+    }
+    if (error.empty() && result != READ_END)
+        error = "Malformed schema at " + reader.where() + " of " + argv[optind];
+    delete solutions;
+    if (!error.empty())
+    {
+        // the writer is closed by now, with the schemas before the error only
+        cout << error << endl;
+        remove(output);
+        return -1;
+    }
+    auto elapsed = chrono::high_resolution_clock::now() - start;
+    auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+
+    cout << "Converted " << count << " schemas." << endl;
+    cout << "Execution took : " << usec << " usecs." << endl;
+    return 0;
+}
+
+// false, after printing both sizes, if filename is a binary file of boards of another size
+static bool sameSize(const PuzzleReader &reader, const char *filename)
+{
+    int n = reader.boxSize() * reader.boxSize();
+    if (n == 0 || n == N)
+        return true;
+    cout << filename << " holds " << n << "x" << n << " boards, this program is compiled for " << N << "x" << N
+         << " ones" << endl;
+    return false;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-s solutions] [-t] <input> <output>\n", argv0);
+    printf("--------------------\n");
+    exit(-1);
+}
@@ -0,0 +1,274 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program implements a solution for the Sudoku problem using standard C++      */
+/* threads that split the work only when some thread runs out of it.                 */
+/* Every thread explores its task sequentially, on the explicit stack of search.cpp, */
+/* without creating any task. A thread with nothing to do declares itself hungry and */
+/* waits; the busy threads look at the number of hungry threads at every node, and   */
+/* one that sees it above zero donates the oldest branches it has not explored yet:  */
+/* the candidates left in the lowest frame of its stack, the biggest subtree it      */
+/* holds. The donated task is the board of that frame with the candidates of its     */
+/* cell restricted to those branches, so it is explored like any other board.        */
+/* The search starts with one task, the whole schema, and ends when a solution is    */
+/* found or when every thread is waiting and no task is left to take.                */
+/* The boards of the tasks come from per-thread slabs (slab.cpp) and are recycled,   */
+/* not freed, once explored.                                                         */
+/*                                                                                   */
+/* Usage : <program_name> [-r rules] [-e engine] [-f input] [-c interval]            */
+/*                        [-k limit] [-a affinity] <nw> <board_index>                */
+/* Where nw=number of workers, board_index=which board you want to be resolved in    */
+/* a [0-9] range taken from the input file,                                          */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt). With dlx, every  */
+/* task is solved to completion by Dancing Links, so nothing is ever donated.        */
+/* interval=nodes explored by a thread between two checks of the cancellation flag   */
+/* raised by the first solution found (default 16).                                  */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* limit=how many solutions to count before stopping (0 for all of them), instead of */
+/* stopping at the first one; the number of solutions found is printed.              */
+/* affinity=placement of the threads on the cpus (compact, scatter, a list of cpus   */
+/* or none; default none), see affinity.cpp.                                         */
+/*************************************************************************************/
+// #define PRINT_OVERHEAD = 1;
+// #define PRINT_SOLUTION = 1;
+// #define STATS = 1;
+
+#include "utils.cpp"
+#include "slab.cpp"
+#include "affinity.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
+#include <condition_variable>
+using namespace std;
+
+// boards of the tasks, thread nw is the master
+slab<Board> *boards;
+
+vector<Board> *solutions;
+vector<bool> *sols_found;
+
+atomic_bool sol_found = false;
+CancelToken cancel_token;
+SolutionCounter counter;
+
+// donated tasks not taken yet and threads waiting for one, under work_mutex
+mutex work_mutex;
+condition_variable work_condition;
+vector<Board *> work;
+int waiting = 0;
+bool done = false;
+// threads waiting minus tasks ready for them, read by the busy threads at every node
+atomic_int hungry(0);
+
+bool setSolution(const Board &my_sol, int tid, bool counted = false);
+Board *takeTask(int nw);
+void donateTask(int tid, const Board &start, Trail &trail, SearchStack &stack);
+void threadBody(int tid, int nw);
+static inline void usage(const char *argv0);
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    string input = "input.txt";
+    while ((opt = getopt(argc, argv, "r:e:f:c:k:a:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'c':
+            if ((cancel_token.interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'k':
+            if ((counter.limit = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'a':
+            if (!parseAffinity(optarg))
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 2)
+        usage(argv[0]);
+
+    int nw = atoi(argv[optind]);
+    int board_index = atoi(argv[optind + 1]);
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, board_index) || nw <= 0)
+        usage(argv[0]);
+
+    boards = new slab<Board>(nw + 1);
+    solutions = new vector<Board>(nw);
+    sols_found = new vector<bool>(nw);
+
+    for (int i = 0; i < nw; i++)
+        sols_found->at(i) = false;
+
+    Board filledGrid = fillGrid(puzzle);
+    counter.token = &cancel_token;
+    auto start = chrono::high_resolution_clock::now();
+    work.push_back(boards->create(nw, filledGrid));
+    vector<thread *> threadPool;
+    for (int i = 0; i < nw; i++)
+        threadPool.push_back(new std::thread(threadBody, i, nw));
+    for (thread *t : threadPool)
+        t->join();
+    auto elapsed = chrono::high_resolution_clock::now() - start;
+    auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+#ifdef PRINT_SOLUTION
+    if (sol_found)
+    {
+        for (int i = 0; i < nw; i++)
+            if ((*sols_found)[i])
+            {
+                printGrid(solutions->at(i));
+                break;
+            }
+    }
+    else if (!counter.counting())
+        cout << "No solution exists\n";
+#endif
+
+    cout << "Execution took : " << usec << " usecs." << endl;
+    if (counter.counting())
+        cout << "Solutions : " << counter.total() << endl;
+    printStats();
+    return 0;
+}
+
+// false if the solutions are being counted and the search goes on; counted if solveDLX
+// has already recorded the solution in the counter
+bool setSolution([[maybe_unused]] const Board &my_sol, [[maybe_unused]] int tid, bool counted)
+{
+    if (counter.counting() && !counted && !counter.found())
+        return false;
+    sol_found = true;
+    cancel_token.cancel();
+#ifdef PRINT_SOLUTION
+    (*solutions)[tid] = my_sol;
+
+    (*sols_found)[tid] = true;
+#endif
+    // the waiting threads have nothing left to wait for
+    std::unique_lock<std::mutex> lock(work_mutex);
+    work_condition.notify_all();
+    return true;
+}
+
+// the next task of the thread, waiting for a donation if there is none; nullptr at the end
+Board *takeTask(int nw)
+{
+    std::unique_lock<std::mutex> lock(work_mutex);
+    if (work.empty())
+    {
+        STAT_START(idle);
+        waiting++;
+        hungry.store(waiting - (int)work.size(), std::memory_order_relaxed);
+        // nobody is left to donate: the whole tree has been explored
+        if (waiting == nw)
+        {
+            done = true;
+            work_condition.notify_all();
+        }
+        while (work.empty() && !done && !cancel_token.cancelled())
+            work_condition.wait(lock);
+        waiting--;
+        STAT_STOP(STAT_IDLE, idle);
+    }
+    if (work.empty())
+        return nullptr;
+    Board *task = work.back();
+    work.pop_back();
+    hungry.store(max(0, waiting - (int)work.size()), std::memory_order_relaxed);
+    return task;
+}
+
+// gives the oldest branches not explored yet to the threads waiting, if any is left
+void donateTask(int tid, const Board &start, Trail &trail, SearchStack &stack)
+{
+    // nothing is copied at the nodes where the thread has nothing to give
+    if (!canDonate(stack))
+        return;
+    Board *task = boards->create(tid, start);
+    int cell = 0;
+    Mask candidates = 0;
+    donate(start, trail, stack, *task, cell, candidates);
+    task->candidates[cell] = candidates;
+    STAT_ADD(STAT_PUSHED, 1);
+    std::unique_lock<std::mutex> lock(work_mutex);
+    work.push_back(task);
+    hungry.store(max(0, waiting - (int)work.size()), std::memory_order_relaxed);
+    work_condition.notify_one();
+}
+
+void threadBody(int tid, int nw)
+{
+    pinThread(tid);
+#ifndef PRINT_OVERHEAD
+    Trail *trail = new Trail();
+    SearchStack *stack = new SearchStack();
+    Board *grid = new Board();
+    Board *task;
+    int countdown = 0;
+    while ((task = takeTask(nw)) != nullptr)
+    {
+        STAT_ADD(STAT_POPPED, 1);
+        bool solved = false;
+        // a donated task is the board of a frame with the cell restricted, propagated once here
+        if (!cancel_token.cancelled() && propagate(*task))
+        {
+            if (engine == ENGINE_DLX)
+                solved = solveDLX(*task, &cancel_token, &counter) && setSolution(*task, tid, true);
+            else
+            {
+                *grid = *task;
+                trail->size = 0;
+                auto leaf = [tid](const Board &solution) { return setSolution(solution, tid); };
+                auto stop = [&] {
+                    if (cancel_token.poll(countdown))
+                        return true;
+                    if (hungry.load(std::memory_order_relaxed) > 0)
+                        donateTask(tid, *task, *trail, *stack);
+                    return false;
+                };
+                solved = search(*grid, *trail, *stack, leaf, stop);
+            }
+        }
+        boards->destroy(tid, task);
+        if (solved)
+            break;
+    }
+    delete grid;
+    delete stack;
+    delete trail;
+#endif
+    return;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-r rules] [-e engine] [-f input] [-c interval] [-k limit]\n", argv0);
+    printf("          [-a affinity] <n_workers> <board_index>\n");
+    printf("--------------------\n");
+    exit(-1);
+}
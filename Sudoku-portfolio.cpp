@@ -0,0 +1,311 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program implements a solution for the Sudoku problem racing a portfolio of   */
+/* sequential searches, one per thread, that differ in the way they branch instead   */
+/* of splitting one solution tree among the threads. The time a board takes depends  */
+/* a lot on the cell and the order of the values tried first, so running different   */
+/* choices at once costs the time of the luckiest one: the first search that solves  */
+/* the schema, or proves it has no solution, wins and cancels the others.            */
+/*                                                                                   */
+/* Every search backtracks on its own copy of the propagated schema (search.cpp),    */
+/* undoing the assignments through its trail, with one of these strategies:          */
+/* mrv   the cell with the fewest candidates (the first one on ties), values in      */
+/*       increasing order, as the other programs do;                                 */
+/* deg   the cell with the fewest candidates, on ties the one with the most empty    */
+/*       peers, so that its value constrains the most cells;                         */
+/* lcv   the cell of mrv, values in order of how few empty peers still have them     */
+/*       among their candidates (least constraining value first);                    */
+/* rand  ties among the cells and the order of the values broken at random, with     */
+/*       restarts from the schema after a number of nodes that follows the Luby      */
+/*       sequence (unit, unit, 2*unit, unit, unit, 2*unit, 4*unit, ...), each with a */
+/*       new random choice; a rand search given more than once uses other seeds.     */
+/*                                                                                   */
+/* Usage : <program_name> [-r rules] [-f input] [-c interval] [-s strategies]        */
+/*                        [-u unit] [-a affinity] <board_index>                      */
+/* Where board_index=which board you want to be resolved in a [0-9] range taken      */
+/* from the input file,                                                              */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt).                   */
+/* interval=nodes explored by a thread between two checks of the cancellation flag   */
+/* raised by the winner (default 16).                                                */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* strategies=comma separated list of the searches to race, one thread each (default */
+/* mrv,deg,lcv,rand) and unit=nodes of the shortest run of rand (default 64).        */
+/* affinity=placement of the threads on the cpus (compact, scatter, a list of cpus   */
+/* or none; default none), see affinity.cpp.                                         */
+/* The strategy that won is printed after the time.                                  */
+/*************************************************************************************/
+// #define PRINT_SOLUTION = 1;
+// #define STATS = 1;
+
+#include "utils.cpp"
+#include "propagation.cpp"
+#include "affinity.cpp"
+#include "search.cpp"
+#include <random>
+#include <sstream>
+using namespace std;
+
+#define STRATEGY_MRV 0
+#define STRATEGY_DEG 1
+#define STRATEGY_LCV 2
+#define STRATEGY_RAND 3
+
+const char *strategy_names[] = {"mrv", "deg", "lcv", "rand"};
+
+// outcome of a search
+#define SEARCH_SOLVED 0
+#define SEARCH_EXHAUSTED 1
+#define SEARCH_STOPPED 2
+
+CancelToken cancel_token;
+long restart_unit = 64;
+
+// first search to finish, -1 while they all run
+atomic_int winner(-1);
+bool solved = false;
+Board solution;
+
+static inline void usage(const char *argv0);
+
+/* Length of run i (from 1) of the Luby sequence: 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ... */
+long luby(long i)
+{
+    long k = 1;
+    while ((1L << k) - 1 < i)
+        k++;
+    if ((1L << k) - 1 == i)
+        return 1L << (k - 1);
+    return luby(i - (1L << (k - 1)) + 1);
+}
+
+struct Search
+{
+    int strategy;
+    mt19937 random;
+    Trail trail;
+    SearchStack stack;
+    // nodes left before the next restart, -1 for a search that never restarts
+    long budget = -1;
+    // nodes left before the cancellation flag is read again
+    int countdown = 0;
+
+    Search(int strategy, unsigned seed) : strategy(strategy), random(seed) {}
+
+    // empty peers of the cell
+    static int degree(const Board &grid, int cell)
+    {
+        int degree = 0;
+        for (int p : peerTable<BOX_SIZE>.peers[cell])
+            degree += grid.value[p] == UNASSIGNED;
+        return degree;
+    }
+
+    // empty peers of the cell that still have num among their candidates
+    static int constrained(const Board &grid, int cell, int num)
+    {
+        int count = 0;
+        for (int p : peerTable<BOX_SIZE>.peers[cell])
+            count += (grid.candidates[p] & DIGIT_BIT(num)) != 0;
+        return count;
+    }
+
+    // the cell to branch on, false if the board is full
+    bool cell(const Board &grid, int &cell)
+    {
+        if (strategy == STRATEGY_MRV || strategy == STRATEGY_LCV)
+        {
+            int row, col;
+            if (!FindUnassignedMinimumLocation(grid, row, col))
+                return false;
+            cell = row * N + col;
+            return true;
+        }
+        int min = N + 1, best = -1, ties = 0;
+        for (int i = 0; i < N * N; i++)
+        {
+            if (grid.value[i] != UNASSIGNED)
+                continue;
+            int size = __builtin_popcount(grid.candidates[i]);
+            if (size < min)
+            {
+                min = size;
+                cell = i;
+                best = strategy == STRATEGY_DEG ? degree(grid, i) : 0;
+                ties = 1;
+            }
+            else if (size == min && strategy == STRATEGY_DEG)
+            {
+                int d = degree(grid, i);
+                if (d > best)
+                {
+                    best = d;
+                    cell = i;
+                }
+            }
+            // reservoir sampling: every tied cell is kept with the same probability
+            else if (size == min && random() % ++ties == 0)
+                cell = i;
+        }
+        return min != N + 1;
+    }
+
+    // the next candidate of the cell to try, among the remaining ones
+    int value(const Board &grid, int cell, Mask remaining)
+    {
+        if (strategy == STRATEGY_LCV)
+        {
+            // the least constraining, the smallest on ties
+            int best = 0, min = INT_MAX;
+            for (Mask mask = remaining; mask; mask &= mask - 1)
+            {
+                int num = __builtin_ctz(mask) + 1, cost = constrained(grid, cell, num);
+                if (cost < min)
+                {
+                    min = cost;
+                    best = num;
+                }
+            }
+            return best;
+        }
+        if (strategy == STRATEGY_RAND)
+            for (int k = random() % __builtin_popcount(remaining); k > 0; k--)
+                remaining &= remaining - 1;
+        return __builtin_ctz(remaining) + 1;
+    }
+
+    // searches the schema to the end on grid, restarting it when the budget runs out
+    int run(const Board &schema, Board &grid)
+    {
+        for (long i = 1;; i++)
+        {
+            grid = schema;
+            trail.size = 0;
+            if (strategy == STRATEGY_RAND)
+                budget = luby(i) * restart_unit;
+            bool stopped = false;
+            auto stop = [&] {
+                stopped = cancel_token.poll(countdown) || (budget >= 0 && budget-- == 0);
+                return stopped;
+            };
+            if (search(grid, trail, stack, [](const Board &) { return true; }, stop, *this))
+                return SEARCH_SOLVED;
+            if (!stopped)
+                return SEARCH_EXHAUSTED;
+            if (cancel_token.cancelled())
+                return SEARCH_STOPPED;
+        }
+    }
+};
+
+void threadBody(int tid, int strategy, const Board &schema)
+{
+    pinThread(tid);
+    Search *search = new Search(strategy, tid + 1);
+    Board grid;
+    int result = search->run(schema, grid);
+    int none = -1;
+    // only the winner writes the result, main reads it after joining the threads
+    if (result != SEARCH_STOPPED && winner.compare_exchange_strong(none, tid))
+    {
+        solved = result == SEARCH_SOLVED;
+        if (solved)
+            solution = grid;
+        cancel_token.cancel();
+    }
+    delete search;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    string input = "input.txt";
+    vector<int> strategies = {STRATEGY_MRV, STRATEGY_DEG, STRATEGY_LCV, STRATEGY_RAND};
+    while ((opt = getopt(argc, argv, "r:f:c:s:u:a:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'c':
+            if ((cancel_token.interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 's':
+        {
+            strategies.clear();
+            stringstream list(optarg);
+            string name;
+            while (getline(list, name, ','))
+            {
+                auto it = find(begin(strategy_names), end(strategy_names), name);
+                if (it == end(strategy_names))
+                    usage(argv[0]);
+                strategies.push_back(it - begin(strategy_names));
+            }
+            if (strategies.empty())
+                usage(argv[0]);
+            break;
+        }
+        case 'u':
+            if ((restart_unit = atol(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'a':
+            if (!parseAffinity(optarg))
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 1)
+        usage(argv[0]);
+
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, atoi(argv[optind])))
+        usage(argv[0]);
+
+    Board schema = fillGrid(puzzle);
+    auto start = chrono::high_resolution_clock::now();
+    // the schema is propagated once, every search starts from there
+    if (propagate(schema))
+    {
+        vector<thread> threads;
+        for (size_t i = 0; i < strategies.size(); i++)
+            threads.push_back(thread(threadBody, i, strategies[i], cref(schema)));
+        for (thread &t : threads)
+            t.join();
+    }
+    auto elapsed = chrono::high_resolution_clock::now() - start;
+    auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+#ifdef PRINT_SOLUTION
+    if (solved)
+        printGrid(solution);
+    else
+        cout << "No solution exists\n";
+#endif
+    cout << "Execution took : " << usec << " usecs." << endl;
+    if (winner >= 0)
+        cout << "Winner : " << strategy_names[strategies[winner]] << " (thread " << winner << ")" << endl;
+    printStats();
+    return 0;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-r rules] [-f input] [-c interval] [-s strategies] [-u unit] [-a affinity]\n", argv0);
+    printf("          <board_index>\n");
+    printf("--------------------\n");
+    exit(-1);
+}
@@ -8,65 +8,99 @@
 /*************************************************************************************/
 /* This program implements a sequential brute force resolution of a Sudoku schema.   */
 /*                                                                                   */
-/* Usage : <program_name> <board_index>                                              */
+/* Usage : <program_name> [-r rules] [-e engine] [-f input] [-k limit] <board_index> */
 /* Where board_index=which board you want to be resolved in a [0-9] range taken      */
-/* from the "input.txt" file.                                                        */
+/* from the input file,                                                              */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt).                  */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* limit=how many solutions to count before stopping (0 for all of them), instead of */
+/* stopping at the first one; the number of solutions found is printed.              */
 /*************************************************************************************/
 // #define PRINT_SOLUTION = 1;
+// #define STATS = 1;
 
 #include "utils.cpp"
 #include "queue.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
+#include <memory>
 using namespace std; 
 
-bool solve(Cell** &grid);
+long nodes = 0;
+SolutionCounter counter;
+
+bool solve(Board &grid, Trail &trail);
 static inline void usage(const char *argv0);
 
 int main(int argc, char* argv[]) 
 {
-    if (argc != 2)
+    int opt;
+    string input = "input.txt";
+    while ((opt = getopt(argc, argv, "r:e:f:k:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'k':
+            if ((counter.limit = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 1)
         usage(argv[0]);
 
-	vector<int**>* grids = new vector<int**>();
-    readGrids(grids, "input.txt");
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, atoi(argv[optind])))
+        usage(argv[0]);
 	
-    Cell** filledGrid = fillGrid((*grids)[atoi(argv[1])]);
+    Board filledGrid = fillGrid(puzzle);
 	auto start = chrono::high_resolution_clock::now();
-    RemoveSingletons(filledGrid);
-    auto result = solve(filledGrid);
+    auto trail = std::make_unique<Trail>();
+    [[maybe_unused]] auto result = propagate(filledGrid, trail.get()) &&
+                  (engine == ENGINE_DLX ? solveDLX(filledGrid, nullptr, &counter, &nodes) : solve(filledGrid, *trail));
 	auto elapsed = chrono::high_resolution_clock::now() - start;
     auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
 #ifdef PRINT_SOLUTION
 	if (result) 
 	 	printGrid(filledGrid); 
-	else
+	else if (!counter.counting())
 	 	cout << "No solution exists\n"; 
 #endif
 	cout << "Execution took : " << usec << " usecs." << endl;
+    if (counter.counting())
+        cout << "Solutions : " << counter.total() << endl;
+#ifdef STATS
+    printStats();
+#else
+	cout << "Search nodes : " << nodes << endl;
+#endif
 	return 0; 
 }
 
 static inline void usage(const char *argv0)
 {
     printf("--------------------\n");
-    printf("Usage: %s <board_index>\n", argv0);
+    printf("Usage: %s [-r rules] [-e engine] [-f input] [-k limit] <board_index>\n", argv0);
     printf("--------------------\n");
     exit(-1);
 }
 
-bool solve(Cell** &grid){
-    int row, col;
-    if(FindUnassignedMinimumLocation(grid, row, col))
-    {
-        for(int num=1;num<=N;num++)
-        {
-            if(isSafe(grid, row, col, num)){
-                grid[row][col].value = num;
-                calculatePossibleValues(grid);
-                if(solve(grid)) return true;
-                grid[row][col].value = UNASSIGNED;
-            }
-        }
-        return false;
-    }
-    return true;
+bool solve(Board &grid, Trail &trail){
+    SearchStack stack;
+    return search(grid, trail, stack, [](const Board &) { return !counter.counting() || counter.found(); },
+                  [] { nodes++; return false; });
 }
\ No newline at end of file
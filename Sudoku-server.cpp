@@ -0,0 +1,410 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program is a Sudoku solving service: it stays up and solves the schemas      */
+/* sent by its clients through a Unix domain socket, so that a schema costs neither  */
+/* starting a process nor reading a file nor creating threads.                       */
+/* The schemas are solved by a fixed pool of threads (pool.cpp), created at the      */
+/* start, and the boards of the tasks come from per-thread slabs (slab.cpp) that     */
+/* are recycled from one request to the next.                                        */
+/* Every client sends one schema per line, in any of the text formats of the input   */
+/* files, and gets one line back per schema, in the same order. All the lines read   */
+/* at once from a client are given to the pool together and solved in parallel.      */
+/* After propagating the rules on a schema, the number of boards its search could    */
+/* visit is estimated from the candidates left: below the threshold the schema is    */
+/* solved sequentially by one thread, above it the tree is split among the threads   */
+/* as Sudoku-DC does, and the first solution found stops the other branches.         */
+/*                                                                                   */
+/* Reply lines are "OK <solution> <policy> <usecs>", where solution has one          */
+/* character per cell as in the compact input format, "NONE <policy> <usecs>" for a  */
+/* schema with no solution and "ERROR <reason>" for a line that is not a schema;     */
+/* policy is seq, par or cache and usecs the time from the moment the line was read  */
+/* to the moment the reply was ready. The line "STATS" gets the number of requests   */
+/* served and the percentiles of their latency, kept in a histogram of fixed size    */
+/* (histogram.cpp); "QUIT" closes the connection.                                    */
+/* A line longer than MAX_LINE bytes gets an "ERROR" and closes the connection too.  */
+/*                                                                                   */
+/* Usage : <program_name> [-r rules] [-e engine] [-s socket] [-d difficulty]         */
+/*                        [-p par_degree] [-m entries] <nw>                          */
+/* Where nw=number of threads of the pool, socket=path of the socket (default        */
+/* "/tmp/sudoku.sock"), difficulty=log2 of the estimated boards over which a schema  */
+/* is solved in parallel (default 100), par_degree=levels of the tree split among    */
+/* the threads (default 2), entries=how many solutions the cache of cache.cpp keeps  */
+/* (default 0, no cache),                                                            */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt).                  */
+/*************************************************************************************/
+
+#include "utils.cpp"
+#include "deque.cpp"
+#include "pool.cpp"
+#include "slab.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
+#include "cache.cpp"
+#include "histogram.cpp"
+#include <cmath>
+#include <future>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+using namespace std;
+
+threadpool *pool;
+// every request is a task of this group, nobody waits for it
+taskgroup requests_group;
+// boards of the parallel searches, one slab per thread of the pool
+slab<Board> *boards;
+solution_cache<BOX_SIZE> *cache = nullptr;
+
+// longest line accepted from a client, far more than any schema takes
+#define MAX_LINE 65536
+
+string socket_path = "/tmp/sudoku.sock";
+double max_difficulty = 100;
+int par_degree = 2;
+
+// latencies of all the requests served, for STATS
+std::mutex stats_mutex;
+LatencyHistogram latencies;
+
+/* One parallel search: the first solution found cancels the other branches */
+struct Search
+{
+    CancelToken token;
+    std::mutex mutex;
+    bool found = false;
+    Board solution;
+};
+
+struct Request
+{
+    chrono::steady_clock::time_point arrival;
+    Puzzle puzzle;
+    std::promise<string> reply;
+};
+
+bool solve(Board &grid, Trail &trail, const CancelToken *token);
+double difficulty(const Board &grid);
+void split(Board *grid, int level, Search &search);
+void serve(Request *request);
+void serveClient(int fd);
+string stats();
+void onSignal(int);
+static inline void usage(const char *argv0);
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    long entries = 0;
+    while ((opt = getopt(argc, argv, "r:e:s:d:p:m:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'd':
+            max_difficulty = atof(optarg);
+            break;
+        case 'p':
+            if ((par_degree = atoi(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'm':
+            if ((entries = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 1)
+        usage(argv[0]);
+
+    int nw = atoi(argv[optind]);
+    if (nw <= 0)
+        usage(argv[0]);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+        usage(argv[0]);
+    strcpy(address.sun_path, socket_path.c_str());
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (server < 0 || ::bind(server, (sockaddr *)&address, sizeof(address)) < 0 || listen(server, 64) < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    pool = new threadpool(nw);
+    boards = new slab<Board>(nw);
+    if (entries > 0)
+        cache = new solution_cache<BOX_SIZE>(entries);
+    cout << "Listening on " << socket_path << " with " << nw << " threads." << endl;
+
+    while (true)
+    {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        thread(serveClient, client).detach();
+    }
+    return 0;
+}
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-r rules] [-e engine] [-s socket] [-d difficulty] [-p par_degree]\n", argv0);
+    printf("          [-m entries] <n_threads>\n");
+    printf("--------------------\n");
+    exit(-1);
+}
+
+void onSignal(int)
+{
+    unlink(socket_path.c_str());
+    _exit(0);
+}
+
+// reads the requests of a client, the replies of the lines read together are sent together
+void serveClient(int fd)
+{
+    string buffer;
+    char data[65536];
+    ssize_t n;
+    bool quit = false;
+    while (!quit && (n = read(fd, data, sizeof(data))) > 0)
+    {
+        buffer.append(data, n);
+        vector<Request *> requests;
+        vector<string> replies;
+        size_t start = 0, end;
+        while (!quit && (end = buffer.find('\n', start)) != string::npos)
+        {
+            const char *line = buffer.data() + start, *line_end = buffer.data() + end;
+            start = end + 1;
+            while (line < line_end && isspace((unsigned char)*line))
+                line++;
+            while (line_end > line && isspace((unsigned char)line_end[-1]))
+                line_end--;
+            string command(line, line_end);
+            if (command.empty())
+                continue;
+            if (command == "QUIT")
+                quit = true;
+            else if (command == "STATS")
+            {
+                // answered below, once the requests before it are
+                requests.push_back(nullptr);
+                replies.push_back("");
+            }
+            else
+            {
+                Request *request = new Request();
+                request->arrival = chrono::steady_clock::now();
+                if (parsePuzzle(line, line_end, request->puzzle) != N * N)
+                {
+                    delete request;
+                    requests.push_back(nullptr);
+                    replies.push_back("ERROR expected " + to_string(N * N) + " cells from 0 to " + to_string(N));
+                    continue;
+                }
+                requests.push_back(request);
+                replies.push_back("");
+                pool->spawn(requests_group, [request]() { serve(request); });
+            }
+        }
+        buffer.erase(0, start);
+
+        string out;
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            if (requests[i] != nullptr)
+            {
+                replies[i] = requests[i]->reply.get_future().get();
+                delete requests[i];
+            }
+            else if (replies[i].empty())
+                replies[i] = stats();
+            out += replies[i] + "\n";
+        }
+        // what is left is the start of a line, a client that never ends it is dropped
+        if (!quit && buffer.size() > MAX_LINE)
+        {
+            out += "ERROR line longer than " + to_string(MAX_LINE) + " bytes\n";
+            quit = true;
+        }
+        for (size_t sent = 0; sent < out.size();)
+        {
+            ssize_t w = write(fd, out.data() + sent, out.size() - sent);
+            if (w <= 0)
+            {
+                quit = true;
+                break;
+            }
+            sent += w;
+        }
+    }
+    close(fd);
+}
+
+// solves the schema of a request and fulfils its reply, runs on a thread of the pool
+void serve(Request *request)
+{
+    const Puzzle *puzzle = &request->puzzle;
+    Canonical canonical;
+    Puzzle solution;
+    bool result = false, cached = false;
+    string policy = "seq";
+    if (cache != nullptr)
+    {
+        canonicalize(*puzzle, canonical);
+        puzzle = &canonical.puzzle;
+        cached = cache->lookup(canonical.puzzle, result, solution);
+        if (cached)
+            policy = "cache";
+    }
+    if (!cached)
+    {
+        Board grid = fillGrid(*puzzle);
+        static thread_local Trail *trail = new Trail();
+        trail->size = 0;
+        if (propagate(grid, trail))
+        {
+            if (difficulty(grid) <= max_difficulty)
+                result = engine == ENGINE_DLX ? solveDLX(grid) : solve(grid, *trail, nullptr);
+            else
+            {
+                policy = "par";
+                Search search;
+                split(boards->create(threadpool::id(), grid), 0, search);
+                result = search.found;
+                if (result)
+                    grid = search.solution;
+            }
+        }
+        memcpy(solution.value, grid.value, sizeof(solution.value));
+        if (cache != nullptr)
+            cache->insert(canonical.puzzle, result, solution);
+    }
+    if (result && cache != nullptr)
+    {
+        Puzzle original;
+        fromCanonical(canonical, solution, original);
+        solution = original;
+    }
+
+    string reply = result ? "OK " : "NONE ";
+    if (result)
+    {
+        for (int i = 0; i < N * N; i++)
+            reply += solution.value[i] <= 9 ? (char)('0' + solution.value[i]) : (char)('A' + solution.value[i] - 10);
+        reply += " ";
+    }
+    long usec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - request->arrival).count();
+    reply += policy + " " + to_string(usec);
+    {
+        std::unique_lock<std::mutex> lock(stats_mutex);
+        latencies.add(usec);
+    }
+    request->reply.set_value(reply);
+}
+
+string stats()
+{
+    std::unique_lock<std::mutex> lock(stats_mutex);
+    long n = latencies.total;
+    auto percentile = [n](double p) { return n == 0 ? 0 : latencies.percentile(p); };
+    string reply = "STATS requests " + to_string(n) + " p50 " + to_string(percentile(0.50)) +
+                   " p90 " + to_string(percentile(0.90)) + " p99 " + to_string(percentile(0.99)) +
+                   " max " + to_string(latencies.max);
+    lock.unlock();
+    if (cache != nullptr)
+        reply += " cache_hits " + to_string(cache->hits());
+    return reply;
+}
+
+// log2 of the boards the search could visit, from the candidates of the empty cells
+double difficulty(const Board &grid)
+{
+    double bits = 0;
+    for (int i = 0; i < N * N; i++)
+        if (grid.value[i] == UNASSIGNED)
+            bits += log2(max(1, __builtin_popcount(grid.candidates[i])));
+    return bits;
+}
+
+// one node of the parallel search, the board is given back to the slabs at the end
+void split(Board *grid, int level, Search &search)
+{
+    int tid = threadpool::id();
+    if (search.token.cancelled() || (level > 0 && !propagate(*grid)))
+    {
+        boards->destroy(tid, grid);
+        return;
+    }
+    int row, col;
+    bool found = false;
+    if (!FindUnassignedMinimumLocation(*grid, row, col))
+        found = true;
+    else if (level == par_degree)
+    {
+        static thread_local Trail *trail = new Trail();
+        trail->size = 0;
+        found = engine == ENGINE_DLX ? solveDLX(*grid, &search.token) : solve(*grid, *trail, &search.token);
+    }
+    else
+    {
+        taskgroup children;
+        Mask mask = grid->candidates[row * N + col];
+        while (mask)
+        {
+            Board *child = boards->create(tid, *grid);
+            assign(*child, row, col, __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+            pool->spawn(children, [child, level, &search]() { split(child, level + 1, search); });
+        }
+        // a helping wait could run the requests queued meanwhile, and count them in
+        // the latency of this one: join only runs the branches of this search
+        pool->join(children);
+    }
+    if (found)
+    {
+        std::unique_lock<std::mutex> lock(search.mutex);
+        if (!search.found)
+        {
+            search.found = true;
+            search.solution = *grid;
+            search.token.cancel();
+        }
+    }
+    boards->destroy(tid, grid);
+}
+
+bool solve(Board &grid, Trail &trail, const CancelToken *token)
+{
+    SearchStack stack;
+    int countdown = 0;
+    return search(grid, trail, stack, [](const Board &) { return true; },
+                  [token, &countdown] { return token != nullptr && token->poll(countdown); });
+}
@@ -10,66 +10,143 @@
 /* threads and one blocking queue shared among all threads.                          */
 /* The structure of the implementation is composed of one thread that pushes the     */
 /* schemas to be resolved in the queue, and a pool of threads that pop the schemas   */
-/* and  expand the solution tree of the schema, push in his own queue the branches   */
-/* of the tree but keep one branch and recursively try to resolve it.                */
+/* and explore their solution tree on the explicit stack of search.cpp: at every     */
+/* node the branches not tried yet are pushed in the queue as one task, the board of */
+/* their frame with the candidates of its cell restricted to them, and the thread    */
+/* goes on down the branch it kept.                                                  */
 /*                                                                                   */
 /* The emitted schemas are selected from the initial schema, choosing the cell with  */
 /* less possible assignable values and enumerating them until a schema with that     */
 /* value assigned has been emitted for each value.                                   */
 /*                                                                                   */
-/* WARNING : due to the nature of this implementation, for a schema with no solution */
-/* the program does not end, the threads remain stuck popping something from the     */
-/* queue that will never arrive. At the moment, I have no solution for this bug.     */
+/* The threads count the tasks still outstanding (pushed and not yet explored):      */
+/* the thread that completes the last one knows the solution tree has been explored  */
+/* without finding a solution, and sends the EOF to every thread stuck popping from  */
+/* the queue, so the program also ends for a schema with no solution.                */
+/* The boards of the tasks come from per-thread slabs (slab.cpp) and are recycled,   */
+/* not freed, once explored.                                                         */
+/* Built with -DLOCKFREE_QUEUE the queue is the bounded lock-free one of queue.cpp   */
+/* (mpmcque, QUEUE_CAPACITY slots) instead of syque: a thread pushes its branches    */
+/* without waiting and keeps on its own stack, to explore them itself, the ones that */
+/* do not fit in the queue; after finding it full, a thread does not try again for   */
+/* DONATE_BACKOFF nodes or until it pops a task.                                     */
+/* The capacity is at least N, so the branches of the root, pushed before any thread */
+/* is started, always fit.                                                           */
+/* make Sudoku-single-queue-lf builds it this way (make QUEUE_CAPACITY=... to size   */
+/* the queue).                                                                       */
 /*                                                                                   */
-/* Usage : <program_name> <nw> <board_index>                                         */
-/* Where nw=number of workers and board_index=which board you want to be resolved in */
-/* a [0-9] range taken from the "input.txt" file.                                    */
+/* Usage : <program_name> [-r rules] [-e engine] [-f input] [-c interval]            */
+/*                        [-k limit] [-a affinity] <nw> <board_index>                */
+/* Where nw=number of workers, board_index=which board you want to be resolved in    */
+/* a [0-9] range taken from the input file,                                          */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt). With dlx, every  */
+/* task is solved to completion by Dancing Links instead of being split further.     */
+/* interval=nodes explored by a thread between two checks of the cancellation flag   */
+/* raised by the first solution found (default 16).                                  */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* limit=how many solutions to count before stopping (0 for all of them), instead of */
+/* stopping at the first one; the number of solutions found is printed.              */
+/* affinity=placement of the threads on the cpus: compact (one NUMA node after the   */
+/* other), scatter (the nodes in turn), a list of cpus (e.g. 0-3,8) or none (the     */
+/* default, left to the scheduler); see affinity.cpp.                                */
 /*************************************************************************************/
 // #define PRINT_OVERHEAD = 1;
 // #define PRINT_SOLUTION = 1;
-// #define PRINT_TIMES = 1;
+// #define STATS = 1;
 
 #include "utils.cpp"
 #include "queue.cpp"
+#include "slab.cpp"
+#include "affinity.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
 using namespace std;
 
-syque<Cell **> task_queue;
+#ifdef LOCKFREE_QUEUE
+#ifndef QUEUE_CAPACITY
+#define QUEUE_CAPACITY 65536
+#endif
+static_assert(QUEUE_CAPACITY >= N, "the queue must hold all the branches of the root");
+mpmcque<Board *> task_queue(QUEUE_CAPACITY);
+#else
+syque<Board *> task_queue;
+#endif
+// nodes a thread that found the queue full explores before trying to donate again
+#define DONATE_BACKOFF 64
+// boards of the tasks, thread nw is the master
+slab<Board> *boards;
 
-vector<Cell **> *solutions;
+vector<Board> *solutions;
 vector<bool> *sols_found;
 
 atomic_bool sol_found = false;
+CancelToken cancel_token;
+SolutionCounter counter;
 
-void setSolution(Cell **my_sol, int tid, int nw);
-bool SolveSudoku(Cell **grid, int tid, int nw);
+// tasks pushed and not yet completed
+atomic_long outstanding(0);
+
+bool setSolution(const Board &my_sol, int tid, int nw, bool counted = false);
+bool donateTask(int tid, const Board &start, Trail &trail, SearchStack &stack);
 void threadBody(int tid, int nw);
 static inline void usage(const char *argv0);
-void solve(Cell **grid, int nw);
+void solve(Board &grid, int nw);
 void sendEOF(int nw);
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    int opt;
+    string input = "input.txt";
+    while ((opt = getopt(argc, argv, "r:e:f:c:k:a:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'c':
+            if ((cancel_token.interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'k':
+            if ((counter.limit = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'a':
+            if (!parseAffinity(optarg))
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 2)
         usage(argv[0]);
 
-    vector<int **> *grids = new vector<int **>();
-    readGrids(grids, "input.txt");
-
-    int nw = atoi(argv[1]);
-    int board_index = atoi(argv[2]);
+    int nw = atoi(argv[optind]);
+    int board_index = atoi(argv[optind + 1]);
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, board_index) || nw <= 0)
+        usage(argv[0]);
 
-    solutions = new vector<Cell **>(nw);
+    boards = new slab<Board>(nw + 1);
+    solutions = new vector<Board>(nw);
     sols_found = new vector<bool>(nw);
 
     for (int i = 0; i < nw; i++)
-    {
-        (*solutions)[i] = new Cell *[N];
-        for (int j = 0; j < N; j++)
-            (*solutions)[i][j] = new Cell[N];
         sols_found->at(i) = false;
-    }
 
-    Cell **filledGrid = fillGrid((*grids)[board_index]);
+    Board filledGrid = fillGrid(puzzle);
+    counter.token = &cancel_token;
     auto start = chrono::high_resolution_clock::now();
     solve(filledGrid, nw);
     auto elapsed = chrono::high_resolution_clock::now() - start;
@@ -84,70 +161,118 @@ int main(int argc, char *argv[])
                 break;
             }
     }
-    else
+    else if (!counter.counting())
         cout << "No solution exists\n";
 #endif
 
     cout << "Execution took : " << usec << " usecs." << endl;
+    if (counter.counting())
+        cout << "Solutions : " << counter.total() << endl;
+    printStats();
     return 0;
 }
 
+// a full queue has no thread waiting to pop, so the EOFs that do not fit are not needed
 void sendEOF(int nw){
-    for(int i=0;i<nw;i++){
-        Cell** c = NULL;
-        task_queue.push(NULL);
-    }
+    for(int i=0;i<nw;i++)
+        task_queue.try_push(NULL);
 }
 
-void setSolution(Cell **my_sol, int tid, int nw)
+// false if the solutions are being counted and the search goes on; counted if solveDLX
+// has already recorded the solution in the counter
+bool setSolution([[maybe_unused]] const Board &my_sol, [[maybe_unused]] int tid, int nw, bool counted)
 {
+    if (counter.counting() && !counted && !counter.found())
+        return false;
     sol_found = true;
+    cancel_token.cancel();
 #ifdef PRINT_SOLUTION
-    for (int i = 0; i < N; i++)
-        for (int j = 0; j < N; j++)
-            (*solutions)[tid][i][j].value = my_sol[i][j].value;
+    (*solutions)[tid] = my_sol;
 
     (*sols_found)[tid] = true;
 #endif
     sendEOF(nw);
+    return true;
 }
 
-bool SolveSudoku(Cell **grid, int tid, int nw)
+// pushes the oldest branches not explored yet in the queue, false if they do not fit
+// in it: then they stay on the stack of the thread, and nothing is copied if the
+// queue is already full
+bool donateTask(int tid, const Board &start, Trail &trail, SearchStack &stack)
 {
-    int row, col;
-    if (FindUnassignedMinimumLocation(grid, row, col))
+    if (task_queue.full())
+        return false;
+    Board *task = boards->create(tid, start);
+    int cell = 0;
+    Mask candidates = 0;
+    donate(start, trail, stack, *task, cell, candidates);
+    task->candidates[cell] = candidates;
+    outstanding.fetch_add(1);
+    if (!task_queue.try_push(task))
     {
-        int size = grid[row][col].possible_values.size();
-        if(size == 0) return false;
-        for(int i=1; i<size; i++)
-        {
-            Cell** new_grid;
-            copyCell(grid, new_grid);
-            new_grid[row][col].value = grid[row][col].possible_values[i];
-            calculatePossibleValues(new_grid);
-            task_queue.push(new_grid);
-        }
-        grid[row][col].value = grid[row][col].possible_values[0];
-        calculatePossibleValues(grid);
-        return SolveSudoku(grid, tid, nw);
+        outstanding.fetch_sub(1);
+        undonate(stack, cell, candidates);
+        boards->destroy(tid, task);
+        return false;
     }
-    setSolution(grid, tid, nw);
+    STAT_ADD(STAT_PUSHED, 1);
     return true;
 }
 
 void threadBody(int tid, int nw)
 {
+    pinThread(tid);
 #ifndef PRINT_OVERHEAD
+    Trail *trail = new Trail();
+    SearchStack *stack = new SearchStack();
+    Board *grid = new Board();
+    // nodes until the cancellation flag is read again, across the tasks of the thread
+    int countdown = 0;
+    // nodes until the thread tries to donate again, after finding the queue full
+    int backoff = 0;
     while(!sol_found){
-        Cell** c = task_queue.pop();
+        Board* c = task_queue.pop();
         if(c==NULL) break;
-        bool solved = SolveSudoku(c, tid, nw);
-        if(solved){
-            free(c);
-            break;
+        STAT_ADD(STAT_POPPED, 1);
+        // the pop made room in the queue
+        backoff = 0;
+        bool solved = false;
+        // a task is the board of a frame with the cell restricted, propagated once here
+        if (!cancel_token.cancelled() && propagate(*c))
+        {
+            if (engine == ENGINE_DLX)
+                solved = solveDLX(*c, &cancel_token, &counter) && setSolution(*c, tid, nw, true);
+            else
+            {
+                *grid = *c;
+                trail->size = 0;
+                auto leaf = [tid, nw](const Board &solution) { return setSolution(solution, tid, nw); };
+                auto stop = [&] {
+                    if (cancel_token.poll(countdown))
+                        return true;
+                    if (backoff > 0)
+                        backoff--;
+                    else
+                        while (canDonate(*stack))
+                            if (!donateTask(tid, *c, *trail, *stack))
+                            {
+                                backoff = DONATE_BACKOFF;
+                                break;
+                            }
+                    return false;
+                };
+                solved = search(*grid, *trail, *stack, leaf, stop);
+            }
         }
-        free(c);
+        boards->destroy(tid, c);
+        if(solved)
+            break;
+        if(outstanding.fetch_sub(1) == 1)
+            sendEOF(nw);
     }
+    delete grid;
+    delete stack;
+    delete trail;
 #endif    
     return;
 };
@@ -155,57 +280,48 @@ void threadBody(int tid, int nw)
 static inline void usage(const char *argv0)
 {
     printf("--------------------\n");
-    printf("Usage: %s <n_workers> <board_index>\n", argv0);
+    printf("Usage: %s [-r rules] [-e engine] [-f input] [-c interval] [-k limit]\n", argv0);
+    printf("          [-a affinity] <n_workers> <board_index>\n");
     printf("--------------------\n");
     exit(-1);
 }
 
-void solve(Cell **grid, int nw)
+void solve(Board &grid, int nw)
 {
-#ifdef PRINT_TIMES
-    auto start_master = chrono::high_resolution_clock::now();
-#endif
-    RemoveSingletons(grid);
+    STAT_START(master);
     vector<thread *> threadPool;
     int row, col;
     int k = 0;
-    FindUnassignedMinimumLocation(grid, row, col);
-    for (int j = 1; j <= N; j++)
+    Board* branches[N];
+    bool consistent = propagate(grid);
+    if (consistent && !FindUnassignedMinimumLocation(grid, row, col))
+        setSolution(grid, 0, nw);
+    else if (consistent) for (int j = 1; j <= N; j++)
     {
-        if (isSafe(grid, row, col, j))
+        if (grid.candidates[row * N + col] & DIGIT_BIT(j))
         {
-            Cell** my_grid;
-            copyCell(grid, my_grid);
+            Board* my_grid = boards->create(nw, grid);
 
-            my_grid[row][col].value = j;
-            calculatePossibleValues(my_grid);
-            task_queue.push(my_grid);
-            k++;
+            assign(*my_grid, row, col, j);
+            branches[k++] = my_grid;
         }
     }
+    // no thread pops yet: a blocking push on a full queue would never return, but the
+    // queue holds at least N boards and push_many takes all of them
+    outstanding += k;
+    task_queue.push_many(branches, branches + k);
+    STAT_ADD(STAT_PUSHED, k);
+    // nothing to explore, let the threads end right away
+    if (k == 0 && !sol_found)
+        sendEOF(nw);
 
     for (int i = 0; i < nw; i++)
         threadPool.push_back(new std::thread(threadBody, i, nw));
 
-#ifdef PRINT_TIMES
-    auto elapsed_master = chrono::high_resolution_clock::now() - start_master;
-    auto usec_master = chrono::duration_cast<chrono::microseconds>(elapsed_master).count();
-
-    cout << "Master took : " << usec_master << " usecs." << endl;
-#endif
-
-#ifdef PRINT_TIMES
-    auto start_worker = chrono::high_resolution_clock::now();
-    for (thread *t : threadPool)
-        t->join();
-    auto elapsed_worker = chrono::high_resolution_clock::now() - start_worker;
-    auto usec_worker = chrono::duration_cast<chrono::microseconds>(elapsed_worker).count();
+    STAT_STOP(STAT_MASTER, master);
 
-    cout << "Workers took : " << usec_worker << " usecs." << endl;
-#else
     for (thread *t : threadPool)
         t->join();
-#endif
 
     return;
 }
\ No newline at end of file
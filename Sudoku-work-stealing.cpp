@@ -0,0 +1,301 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+/*************************************************************************************/
+/* This program implements a solution for the Sudoku problem using standard C++      */
+/* threads and one work-stealing deque per thread.                                   */
+/* Every thread explores its task on the explicit stack of search.cpp and keeps one */
+/* task in its own deque for the others: whenever the deque is found empty at a      */
+/* node, the oldest branches not explored yet, the candidates left in the lowest     */
+/* frame of the stack, are pushed in it as a task (the board of that frame with the  */
+/* candidates of its cell restricted to them). The thread pops its tasks back in     */
+/* LIFO order, so it keeps working on the boards it just touched. A thread whose     */
+/* deque is empty steals the oldest task of another thread, picking victims at       */
+/* random, so no lock is shared among the threads.                                   */
+/*                                                                                   */
+/* The emitted schemas are selected from the initial schema, choosing the cell with  */
+/* less possible assignable values and enumerating them, and they are dealt to the   */
+/* deques in round robin before the threads start.                                   */
+/* The threads count the tasks still pending, so they all stop when the solution     */
+/* tree has been explored even if the schema has no solution.                        */
+/* The boards of the tasks come from per-thread slabs (slab.cpp) and are recycled,   */
+/* not freed, once explored.                                                         */
+/*                                                                                   */
+/* Usage : <program_name> [-r rules] [-e engine] [-f input] [-c interval]            */
+/*                        [-k limit] [-a affinity] <nw> <board_index>                */
+/* Where nw=number of workers, board_index=which board you want to be resolved in    */
+/* a [0-9] range taken from the input file,                                          */
+/* rules=comma separated list of the propagation rules applied at every node of      */
+/* the tree (ns,hs,np,hp,nt,ht,pt, all or none; default ns,hs,pt) and engine=search  */
+/* engine (bt for backtracking, dlx for Dancing Links; default bt). With dlx, every  */
+/* task is solved to completion by Dancing Links instead of being split further.     */
+/* interval=nodes explored by a thread between two checks of the cancellation flag   */
+/* raised by the first solution found (default 16).                                  */
+/* input=file the boards are read from, text or binary (default "input.txt").        */
+/* limit=how many solutions to count before stopping (0 for all of them), instead of */
+/* stopping at the first one; the number of solutions found is printed.              */
+/* affinity=placement of the threads on the cpus: compact (one NUMA node after the   */
+/* other), scatter (the nodes in turn), a list of cpus (e.g. 0-3,8) or none (the     */
+/* default, left to the scheduler); see affinity.cpp.                                */
+/*************************************************************************************/
+// #define PRINT_OVERHEAD = 1;
+// #define PRINT_SOLUTION = 1;
+// #define STATS = 1;
+
+#include "utils.cpp"
+#include "deque.cpp"
+#include "slab.cpp"
+#include "affinity.cpp"
+#include "propagation.cpp"
+#include "dlx.cpp"
+#include "search.cpp"
+using namespace std;
+
+vector<wsdeque<Board *>> *deques;
+// boards of the tasks, thread nw is the master
+slab<Board> *boards;
+
+vector<Board> *solutions;
+vector<bool> *sols_found;
+
+atomic_bool sol_found = false;
+CancelToken cancel_token;
+SolutionCounter counter;
+
+// tasks pushed and not yet completed
+atomic_long pending(0);
+
+bool setSolution(const Board &my_sol, int tid, bool counted = false);
+void donateTask(int tid, const Board &start, Trail &trail, SearchStack &stack);
+bool steal(int tid, int nw, unsigned &seed, Board *&task);
+void threadBody(int tid, int nw);
+static inline void usage(const char *argv0);
+void solve(Board &grid, int nw);
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    string input = "input.txt";
+    while ((opt = getopt(argc, argv, "r:e:f:c:k:a:")) != -1)
+        switch (opt)
+        {
+        case 'r':
+            if ((rules = parseRules(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'e':
+            if ((engine = parseEngine(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'f':
+            input = optarg;
+            break;
+        case 'c':
+            if ((cancel_token.interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'k':
+            if ((counter.limit = atol(optarg)) < 0)
+                usage(argv[0]);
+            break;
+        case 'a':
+            if (!parseAffinity(optarg))
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    if (argc - optind != 2)
+        usage(argv[0]);
+
+    int nw = atoi(argv[optind]);
+    int board_index = atoi(argv[optind + 1]);
+    Puzzle puzzle;
+    if (!readGrid(puzzle, input, board_index) || nw <= 0)
+        usage(argv[0]);
+
+    deques = new vector<wsdeque<Board *>>(nw);
+    boards = new slab<Board>(nw + 1);
+    solutions = new vector<Board>(nw);
+    sols_found = new vector<bool>(nw);
+
+    for (int i = 0; i < nw; i++)
+        sols_found->at(i) = false;
+
+    Board filledGrid = fillGrid(puzzle);
+    counter.token = &cancel_token;
+    auto start = chrono::high_resolution_clock::now();
+    solve(filledGrid, nw);
+    auto elapsed = chrono::high_resolution_clock::now() - start;
+    auto usec = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+#ifdef PRINT_SOLUTION
+    if (sol_found)
+    {
+        for (int i = 0; i < nw; i++)
+            if ((*sols_found)[i])
+            {
+                printGrid(solutions->at(i));
+                break;
+            }
+    }
+    else if (!counter.counting())
+        cout << "No solution exists\n";
+#endif
+
+    cout << "Execution took : " << usec << " usecs." << endl;
+    if (counter.counting())
+        cout << "Solutions : " << counter.total() << endl;
+    printStats();
+    return 0;
+}
+
+// false if the solutions are being counted and the search goes on; counted if solveDLX
+// has already recorded the solution in the counter
+bool setSolution([[maybe_unused]] const Board &my_sol, [[maybe_unused]] int tid, bool counted)
+{
+    if (counter.counting() && !counted && !counter.found())
+        return false;
+    sol_found = true;
+    cancel_token.cancel();
+#ifdef PRINT_SOLUTION
+    (*solutions)[tid] = my_sol;
+
+    (*sols_found)[tid] = true;
+#endif
+    return true;
+}
+
+// pushes the oldest branches not explored yet in the deque of the thread, if any is left
+void donateTask(int tid, const Board &start, Trail &trail, SearchStack &stack)
+{
+    // nothing is copied at the nodes where the thread has nothing to give
+    if (!canDonate(stack))
+        return;
+    Board *task = boards->create(tid, start);
+    int cell = 0;
+    Mask candidates = 0;
+    donate(start, trail, stack, *task, cell, candidates);
+    task->candidates[cell] = candidates;
+    pending.fetch_add(1);
+    STAT_ADD(STAT_PUSHED, 1);
+    (*deques)[tid].push(task);
+}
+
+bool steal(int tid, int nw, unsigned &seed, Board *&task)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    int victim = seed % nw;
+    for (int i = 0; i < nw; i++, victim = (victim + 1) % nw)
+        if (victim != tid && (*deques)[victim].steal(task))
+            return true;
+    return false;
+}
+
+void threadBody(int tid, int nw)
+{
+    pinThread(tid);
+#ifndef PRINT_OVERHEAD
+    Trail *trail = new Trail();
+    SearchStack *stack = new SearchStack();
+    Board *grid = new Board();
+    unsigned seed = tid + 1;
+    // nodes until the cancellation flag is read again, across the tasks of the thread
+    int countdown = 0;
+    Board* c;
+    while(!sol_found){
+        bool popped = (*deques)[tid].pop(c);
+        if(popped || steal(tid, nw, seed, c)){
+            STAT_ADD(popped ? STAT_POPPED : STAT_STOLEN, 1);
+            bool solved = false;
+            // a task is the board of a frame with the cell restricted, propagated once here
+            if (!cancel_token.cancelled() && propagate(*c))
+            {
+                if (engine == ENGINE_DLX)
+                    solved = solveDLX(*c, &cancel_token, &counter) && setSolution(*c, tid, true);
+                else
+                {
+                    *grid = *c;
+                    trail->size = 0;
+                    auto leaf = [tid](const Board &solution) { return setSolution(solution, tid); };
+                    auto stop = [&] {
+                        if (cancel_token.poll(countdown))
+                            return true;
+                        if ((*deques)[tid].empty())
+                            donateTask(tid, *c, *trail, *stack);
+                        return false;
+                    };
+                    solved = search(*grid, *trail, *stack, leaf, stop);
+                }
+            }
+            boards->destroy(tid, c);
+            pending.fetch_sub(1);
+            if(solved)
+                break;
+        }
+        else if(pending.load() == 0)
+            break;
+        else{
+            STAT_START(idle);
+            this_thread::yield();
+            STAT_STOP(STAT_IDLE, idle);
+        }
+    }
+    delete grid;
+    delete stack;
+    delete trail;
+#endif
+    return;
+};
+
+static inline void usage(const char *argv0)
+{
+    printf("--------------------\n");
+    printf("Usage: %s [-r rules] [-e engine] [-f input] [-c interval] [-k limit]\n", argv0);
+    printf("          [-a affinity] <n_workers> <board_index>\n");
+    printf("--------------------\n");
+    exit(-1);
+}
+
+void solve(Board &grid, int nw)
+{
+    STAT_START(master);
+    vector<thread *> threadPool;
+    int row, col;
+    int k = 0;
+    if (!propagate(grid))
+        return;
+    if (!FindUnassignedMinimumLocation(grid, row, col))
+    {
+        setSolution(grid, 0);
+        return;
+    }
+    for (int j = 1; j <= N; j++)
+    {
+        if (grid.candidates[row * N + col] & DIGIT_BIT(j))
+        {
+            Board* my_grid = boards->create(nw, grid);
+
+            assign(*my_grid, row, col, j);
+            (*deques)[k % nw].push(my_grid);
+            STAT_ADD(STAT_PUSHED, 1);
+            pending++;
+            k++;
+        }
+    }
+
+    for (int i = 0; i < nw; i++)
+        threadPool.push_back(new std::thread(threadBody, i, nw));
+
+    STAT_STOP(STAT_MASTER, master);
+
+    for (thread *t : threadPool)
+        t->join();
+
+    return;
+}
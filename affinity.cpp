@@ -0,0 +1,162 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements the placement of the threads of the parallel programs on   */
+/* the cpus of the machine. With a policy set (see parseAffinity) every thread pins */
+/* itself, when it starts, to the cpu given to its id: "compact" fills the cpus of  */
+/* one NUMA node before moving to the next one, "scatter" deals the threads to the  */
+/* nodes in turn, on different physical cores first, and a list of cpus gives them */
+/* explicitly in the order of the ids. The topology is read from /sys, and only the */
+/* cpus the process is allowed to run on are used.                                 */
+/* Memory is placed by the first thread that touches it, so what a pinned thread    */
+/* allocates and fills itself (the chunks of its slab, its trail) stays on its own  */
+/* node: the drivers pin their threads before they allocate anything.              */
+/* It relies on utils.cpp, include that first.                                     */
+
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <tuple>
+
+/* Cpus of the threads in order of id (wrapping around when there are more threads */
+/* than cpus), empty if the threads are left to the scheduler. Set from the        */
+/* command line.                                                                   */
+std::vector<int> affinity_cpus;
+
+struct CpuInfo
+{
+    int cpu, node, package, core;
+    // 0 for the first hardware thread of its core, 1 for the second and so on
+    int sibling;
+};
+
+static int readSysInt(const string &path, int fallback)
+{
+    ifstream in(path);
+    int value;
+    return in >> value ? value : fallback;
+}
+
+/* Parses a list of numbers and ranges separated by commas (e.g. 0-3,8), */
+/* the format of the cpu lists of /sys too.                              */
+bool parseCpuList(const string &list, std::vector<int> &cpus)
+{
+    stringstream items(list);
+    string item;
+    while (getline(items, item, ','))
+    {
+        int first, last;
+        char dash;
+        stringstream range(item);
+        if (!(range >> first) || first < 0)
+            return false;
+        last = first;
+        if (range >> dash && (dash != '-' || !(range >> last) || last < first))
+            return false;
+        for (int c = first; c <= last; c++)
+            cpus.push_back(c);
+    }
+    return !cpus.empty();
+}
+
+/* The cpus the process can run on, with their node, package and core */
+std::vector<CpuInfo> readTopology()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return {};
+    std::vector<int> nodes(CPU_SETSIZE, 0);
+    if (DIR *dir = opendir("/sys/devices/system/node"))
+    {
+        while (struct dirent *entry = readdir(dir))
+        {
+            int node;
+            std::vector<int> cpus;
+            ifstream in(string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+            string list;
+            if (sscanf(entry->d_name, "node%d", &node) != 1 || !getline(in, list) || !parseCpuList(list, cpus))
+                continue;
+            for (int c : cpus)
+                if (c < CPU_SETSIZE)
+                    nodes[c] = node;
+        }
+        closedir(dir);
+    }
+    std::vector<CpuInfo> topology;
+    for (int c = 0; c < CPU_SETSIZE; c++)
+    {
+        if (!CPU_ISSET(c, &allowed))
+            continue;
+        string path = "/sys/devices/system/cpu/cpu" + to_string(c) + "/topology/";
+        CpuInfo info = {c, nodes[c], readSysInt(path + "physical_package_id", 0), readSysInt(path + "core_id", c), 0};
+        for (const CpuInfo &other : topology)
+            if (other.package == info.package && other.core == info.core)
+                info.sibling++;
+        topology.push_back(info);
+    }
+    return topology;
+}
+
+/* Sets affinity_cpus from "none", "compact", "scatter" or a list of cpus.       */
+/* Returns false if the policy is unknown or lists a cpu the process cannot use. */
+bool parseAffinity(const char *policy)
+{
+    std::vector<CpuInfo> topology = readTopology();
+    string p(policy);
+    affinity_cpus.clear();
+    if (p == "none")
+        return true;
+    if (topology.empty())
+        return false;
+    if (p == "compact")
+    {
+        sort(topology.begin(), topology.end(), [](const CpuInfo &a, const CpuInfo &b) {
+            return make_tuple(a.node, a.package, a.core, a.sibling) < make_tuple(b.node, b.package, b.core, b.sibling);
+        });
+        for (const CpuInfo &info : topology)
+            affinity_cpus.push_back(info.cpu);
+        return true;
+    }
+    if (p == "scatter")
+    {
+        // the cpus of every node, other cores before the second threads of the same core
+        sort(topology.begin(), topology.end(), [](const CpuInfo &a, const CpuInfo &b) {
+            return make_tuple(a.node, a.sibling, a.package, a.core) < make_tuple(b.node, b.sibling, b.package, b.core);
+        });
+        std::vector<std::vector<int>> nodes;
+        for (size_t i = 0; i < topology.size(); i++)
+        {
+            if (i == 0 || topology[i].node != topology[i - 1].node)
+                nodes.emplace_back();
+            nodes.back().push_back(topology[i].cpu);
+        }
+        for (size_t i = 0; affinity_cpus.size() < topology.size(); i++)
+            for (const std::vector<int> &cpus : nodes)
+                if (i < cpus.size())
+                    affinity_cpus.push_back(cpus[i]);
+        return true;
+    }
+    if (!parseCpuList(p, affinity_cpus))
+        return false;
+    for (int c : affinity_cpus)
+        if (none_of(topology.begin(), topology.end(), [c](const CpuInfo &info) { return info.cpu == c; }))
+            return false;
+    return true;
+}
+
+/* Pins the calling thread to the cpu of thread tid, if a policy is set */
+void pinThread(int tid)
+{
+    if (affinity_cpus.empty())
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(affinity_cpus[tid % affinity_cpus.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
@@ -0,0 +1,329 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements a cache of solved boards shared by many threads.           */
+/* Boards that only differ by the names of the digits, by the order of the rows    */
+/* inside a band, of the bands, of the columns inside a stack, of the stacks, or   */
+/* by a transposition have the same solutions up to the same transformation, so    */
+/* they are stored once under their canonical form: the smallest of all their     */
+/* transformations, read row by row with the digits renamed in order of first      */
+/* appearance and empty cells last.  The cache is split in shards, each one with   */
+/* its own lock, picked by the hash of the canonical form.                         */
+/* It relies on the Board and Puzzle types of utils.cpp, include that first.       */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+/* Transformations of the boards kept while looking for the canonical form, past */
+/* this many ties only the first ones found are followed: the form is still a    */
+/* transformation of the board (so the solutions map back correctly) but boards  */
+/* with many empty rows may not get the same form as all their equivalent ones.  */
+#define CANONICAL_STATES 4096
+
+template <int B>
+struct CanonicalT
+{
+    static constexpr int N = B * B;
+    PuzzleT<B> puzzle;
+    // rows and columns of the board swapped before permuting them
+    bool transposed;
+    // row i of the canonical form is row rows[i] of the (transposed) board, the same for columns
+    uint8_t rows[N], cols[N];
+    // digit d of the board is labels[d] in the canonical form
+    uint8_t labels[N + 1];
+};
+
+/* Computes the canonical form of a board and the transformation that gives it.    */
+/* Rows are chosen one at a time, keeping every choice of rows and columns that    */
+/* gives the smallest canonical form so far. The digits of a row are all different, */
+/* so the first row only depends on which of its cells are given: the best ones    */
+/* have the stacks with most givens first and the givens first in every stack, and */
+/* only the orders of the columns that do that are tried. Only the digits are      */
+/* renamed for boards bigger than 9x9, whose orders of the columns are too many.   */
+template <int B>
+void canonicalize(const PuzzleT<B> &puzzle, CanonicalT<B> &canonical)
+{
+    constexpr int N = B * B;
+    constexpr bool permute = B <= 3;
+    struct State
+    {
+        bool transposed;
+        uint8_t rows[N], cols[N];
+        uint32_t used;
+        uint8_t labels[N + 1];
+        uint8_t next;
+    };
+    static thread_local std::vector<State> states, next_states;
+    static const std::vector<std::array<uint8_t, B>> perms = [] {
+        std::vector<std::array<uint8_t, B>> perms;
+        std::array<uint8_t, B> p;
+        for (int i = 0; i < B; i++)
+            p[i] = i;
+        do
+            perms.push_back(p);
+        while (std::next_permutation(p.begin(), p.end()));
+        return perms;
+    }();
+
+    uint8_t grid[2][N][N];
+    for (int r = 0; r < N; r++)
+        for (int c = 0; c < N; c++)
+            grid[0][r][c] = grid[1][c][r] = puzzle.value[r * N + c];
+
+    states.clear();
+    if (!permute)
+    {
+        State s = {};
+        for (int i = 0; i < N; i++)
+            s.cols[i] = i;
+        s.next = 1;
+        states.push_back(s);
+    }
+    else
+    {
+        // givens of every stack, sorted: the more in the first stacks the better
+        std::array<int, B> best = {};
+        best[0] = -1;
+        for (int t = 0; t < 2; t++)
+            for (int r = 0; r < N; r++)
+            {
+                const uint8_t *row = grid[t][r];
+                std::array<int, B> count = {};
+                for (int c = 0; c < N; c++)
+                    count[c / B] += row[c] != UNASSIGNED;
+                std::array<int, B> sorted = count;
+                std::sort(sorted.begin(), sorted.end(), std::greater<int>());
+                if (sorted < best)
+                    continue;
+                if (sorted > best)
+                {
+                    best = sorted;
+                    states.clear();
+                }
+                // one choice of the order of the stacks and of the columns inside each one at a time
+                std::vector<int> choice(B + 1, 0);
+                while (choice[B] < (int)perms.size())
+                {
+                    const std::array<uint8_t, B> &stacks = perms[choice[B]];
+                    bool good = true;
+                    for (int i = 1; i < B && good; i++)
+                        good = count[stacks[i - 1]] >= count[stacks[i]];
+                    State s = {};
+                    s.transposed = t;
+                    s.rows[0] = r;
+                    s.used = 1u << r;
+                    s.next = 1;
+                    for (int i = 0; i < B && good; i++)
+                        for (int k = 0; k < B && good; k++)
+                        {
+                            int c = stacks[i] * B + perms[choice[i]][k];
+                            good = k == 0 || row[c] == UNASSIGNED || row[s.cols[i * B + k - 1]] != UNASSIGNED;
+                            s.cols[i * B + k] = c;
+                            if (row[c] != UNASSIGNED)
+                                s.labels[row[c]] = s.next++;
+                        }
+                    if (good && states.size() < CANONICAL_STATES)
+                        states.push_back(s);
+                    int i = 0;
+                    while (i < B && ++choice[i] == (int)perms.size())
+                        choice[i++] = 0;
+                    if (i == B)
+                        choice[B]++;
+                }
+            }
+    }
+
+    for (int level = permute ? 1 : 0; level < N; level++)
+    {
+        uint8_t best[N];
+        bool first = true;
+        next_states.clear();
+        for (const State &s : states)
+            for (int r = 0; r < N; r++)
+            {
+                // the next row is any row of a band not used yet, or one of the rest of the current band
+                if (!permute ? r != level
+                             : level % B == 0 ? (s.used >> (r / B * B) & ((1u << B) - 1)) != 0
+                                              : r / B != s.rows[level - 1] / B || (s.used >> r & 1))
+                    continue;
+                State n = s;
+                n.rows[level] = r;
+                n.used |= 1u << r;
+                uint8_t row[N];
+                int cmp = first ? -1 : 0;
+                for (int j = 0; j < N && cmp <= 0; j++)
+                {
+                    uint8_t v = grid[s.transposed][r][s.cols[j]];
+                    if (v != UNASSIGNED && n.labels[v] == 0)
+                        n.labels[v] = n.next++;
+                    // empty cells compare after the digits, so the fullest rows come first and few choices tie
+                    row[j] = v == UNASSIGNED ? N + 1 : n.labels[v];
+                    if (cmp == 0 && row[j] != best[j])
+                        cmp = row[j] < best[j] ? -1 : 1;
+                }
+                if (cmp > 0)
+                    continue;
+                if (cmp < 0)
+                {
+                    memcpy(best, row, sizeof(best));
+                    first = false;
+                    next_states.clear();
+                }
+                if (next_states.size() < CANONICAL_STATES)
+                    next_states.push_back(n);
+            }
+        std::swap(states, next_states);
+    }
+
+    // any of the transformations left gives the same form, the digits missing from the board take the last labels
+    const State &s = states[0];
+    canonical.transposed = s.transposed;
+    memcpy(canonical.rows, s.rows, sizeof(canonical.rows));
+    memcpy(canonical.cols, s.cols, sizeof(canonical.cols));
+    memcpy(canonical.labels, s.labels, sizeof(canonical.labels));
+    int next = s.next;
+    for (int d = 1; d <= N; d++)
+        if (canonical.labels[d] == 0)
+            canonical.labels[d] = next++;
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+            canonical.puzzle.value[i * N + j] = canonical.labels[grid[s.transposed][s.rows[i]][s.cols[j]]];
+}
+
+/* Maps a board in canonical form (e.g. its solution) back to the original one */
+template <int B>
+void fromCanonical(const CanonicalT<B> &canonical, const PuzzleT<B> &in, PuzzleT<B> &out)
+{
+    constexpr int N = B * B;
+    uint8_t digits[N + 1];
+    for (int d = 0; d <= N; d++)
+        digits[canonical.labels[d]] = d;
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+        {
+            int r = canonical.rows[i], c = canonical.cols[j];
+            if (canonical.transposed)
+                std::swap(r, c);
+            out.value[r * N + c] = digits[in.value[i * N + j]];
+        }
+}
+
+/* Solutions of canonical forms, at most capacity of them: a full shard forgets */
+/* its oldest entry. Boards with no solution are remembered as well.            */
+template <int B>
+class solution_cache
+{
+private:
+    struct Hash
+    {
+        size_t operator()(const PuzzleT<B> &p) const
+        {
+            // FNV-1a
+            size_t h = 14695981039346656037ull;
+            for (uint8_t v : p.value)
+                h = (h ^ v) * 1099511628211ull;
+            return h;
+        }
+    };
+
+    struct Equal
+    {
+        bool operator()(const PuzzleT<B> &a, const PuzzleT<B> &b) const
+        {
+            return memcmp(a.value, b.value, sizeof(a.value)) == 0;
+        }
+    };
+
+    struct Entry
+    {
+        bool solved;
+        PuzzleT<B> solution;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<PuzzleT<B>, Entry, Hash, Equal> entries;
+        std::deque<PuzzleT<B>> order;
+        long hits = 0, misses = 0;
+        long capacity;
+    };
+
+    int nshards;
+    Shard *shards;
+
+    Shard &shardOf(const PuzzleT<B> &canonical)
+    {
+        return shards[(Hash()(canonical) >> 32) % nshards];
+    }
+
+public:
+    // no more shards than entries, and the remainder of the division spread over the
+    // first shards, so that together they hold capacity entries
+    solution_cache(long capacity, int nshards = 64) : nshards((int)std::max(1L, std::min((long)nshards, capacity)))
+    {
+        shards = new Shard[this->nshards];
+        for (int i = 0; i < this->nshards; i++)
+            shards[i].capacity = std::max(1L, capacity / this->nshards + (i < capacity % this->nshards));
+    }
+
+    ~solution_cache() { delete[] shards; }
+
+    // true if the canonical form is known: solved tells if it has a solution, and solution is that
+    bool lookup(const PuzzleT<B> &canonical, bool &solved, PuzzleT<B> &solution)
+    {
+        Shard &s = shardOf(canonical);
+        std::unique_lock<std::mutex> lock(s.mutex);
+        auto it = s.entries.find(canonical);
+        if (it == s.entries.end())
+        {
+            s.misses++;
+            return false;
+        }
+        s.hits++;
+        solved = it->second.solved;
+        if (solved)
+            solution = it->second.solution;
+        return true;
+    }
+
+    void insert(const PuzzleT<B> &canonical, bool solved, const PuzzleT<B> &solution)
+    {
+        Shard &s = shardOf(canonical);
+        std::unique_lock<std::mutex> lock(s.mutex);
+        if (!s.entries.emplace(canonical, Entry{solved, solution}).second)
+            return;
+        s.order.push_back(canonical);
+        if ((long)s.order.size() > s.capacity)
+        {
+            s.entries.erase(s.order.front());
+            s.order.pop_front();
+        }
+    }
+
+    long hits() { return sum(&Shard::hits); }
+
+    long misses() { return sum(&Shard::misses); }
+
+private:
+    long sum(long Shard::*counter)
+    {
+        long total = 0;
+        for (int i = 0; i < nshards; i++)
+        {
+            std::unique_lock<std::mutex> lock(shards[i].mutex);
+            total += shards[i].*counter;
+        }
+        return total;
+    }
+};
+
+typedef CanonicalT<BOX_SIZE> Canonical;
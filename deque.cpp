@@ -0,0 +1,123 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements a work-stealing deque (Chase-Lev), following the C11      */
+/* formulation of Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient       */
+/* Work-Stealing for Weak Memory Models" (PPoPP 2013).                            */
+/* The owner pushes and pops at the bottom (LIFO, good locality), any other thread */
+/* steals from the top (FIFO, oldest and usually biggest tasks). No locks are      */
+/* taken: the owner only synchronizes with thieves when one element is left.       */
+
+#include <atomic>
+#include <vector>
+
+template <typename T>
+class wsdeque
+{
+private:
+  struct Array
+  {
+    long capacity;
+    std::atomic<T> *buffer;
+
+    Array(long capacity) : capacity(capacity), buffer(new std::atomic<T>[capacity]) {}
+    ~Array() { delete[] buffer; }
+
+    T get(long i) { return buffer[i & (capacity - 1)].load(std::memory_order_relaxed); }
+    void put(long i, T x) { buffer[i & (capacity - 1)].store(x, std::memory_order_relaxed); }
+  };
+
+  // top and bottom live on different cache lines, thieves only touch top
+  alignas(64) std::atomic<long> top;
+  alignas(64) std::atomic<long> bottom;
+  std::atomic<Array *> array;
+  // replaced arrays, a thief may still be reading them until the deque dies
+  std::vector<Array *> garbage;
+
+  Array *grow(Array *a, long b, long t)
+  {
+    Array *bigger = new Array(a->capacity * 2);
+    for (long i = t; i < b; i++)
+      bigger->put(i, a->get(i));
+    garbage.push_back(a);
+    array.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+public:
+  wsdeque(long capacity = 1024) : top(0), bottom(0), array(new Array(capacity)) {}
+
+  ~wsdeque()
+  {
+    delete array.load();
+    for (Array *a : garbage)
+      delete a;
+  }
+
+  // owner only
+  void push(T x)
+  {
+    long b = bottom.load(std::memory_order_relaxed);
+    long t = top.load(std::memory_order_acquire);
+    Array *a = array.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1)
+      a = grow(a, b, t);
+    a->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // owner only, returns false if the deque is empty
+  bool pop(T &x)
+  {
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    Array *a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+    bool found = true;
+    if (t <= b)
+    {
+      x = a->get(b);
+      if (t == b)
+      {
+        // last element, race against the thieves
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+          found = false;
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      found = false;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return found;
+  }
+
+  // any thread, returns false if the deque is empty or the race was lost
+  bool steal(T &x)
+  {
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+    if (t < b)
+    {
+      Array *a = array.load(std::memory_order_acquire);
+      x = a->get(t);
+      return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+    return false;
+  }
+
+  // approximate, for idle checks only
+  bool empty()
+  {
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+  }
+};
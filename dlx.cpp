@@ -0,0 +1,210 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements the Dancing Links (Algorithm X) solver engine.             */
+/* The board is modelled as an exact cover problem with four constraints per       */
+/* candidate (cell filled, digit in row, digit in column, digit in box). The       */
+/* matrix only holds the candidates still open on the board, and it is stored in   */
+/* flat arrays indexed by node id instead of heap allocated linked nodes.          */
+/* It relies on the Board primitives of utils.cpp, include that first.             */
+
+#define ENGINE_BT 0
+#define ENGINE_DLX 1
+
+/* Search engine used by the drivers, set from the command line */
+int engine = ENGINE_BT;
+
+/* Returns the engine named by name ("bt" or "dlx"), or -1 if unknown */
+int parseEngine(const char *name)
+{
+    if (string(name) == "bt")
+        return ENGINE_BT;
+    if (string(name) == "dlx")
+        return ENGINE_DLX;
+    return -1;
+}
+
+template <int B>
+struct DLX
+{
+    static constexpr int N = B * B;
+    static constexpr int DLX_COLUMNS = 4 * N * N;
+    static constexpr int DLX_NODES = 1 + DLX_COLUMNS + 4 * N * N * N;
+
+    // node 0 is the root, nodes 1..DLX_COLUMNS the column headers
+    int left[DLX_NODES], right[DLX_NODES], up[DLX_NODES], down[DLX_NODES];
+    int column[DLX_NODES];
+    // candidate encoded as cell * N + (num - 1), only for row nodes
+    int candidate[DLX_NODES];
+    int size[DLX_COLUMNS + 1];
+    // chosen candidates, terminated by -1
+    int solution[N * N + 1];
+    int nodes;
+    // nodes of the search tree expanded so far
+    long expanded = 0;
+    const CancelToken *token = nullptr;
+    int countdown = 0;
+    // when counting, every exact cover found is recorded here and the search goes on
+    SolutionCounter *counter = nullptr;
+
+    void build(const BoardT<B> &grid)
+    {
+        for (int c = 0; c <= DLX_COLUMNS; c++)
+        {
+            left[c] = right[c] = up[c] = down[c] = column[c] = c;
+            size[c] = 0;
+        }
+        nodes = DLX_COLUMNS + 1;
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            typename BoardT<B>::Mask mask = grid.candidates[cell];
+            while (mask)
+            {
+                int d = __builtin_ctz(mask);
+                mask &= mask - 1;
+                int row = cell / N, col = cell % N;
+                int cols[4] = {1 + cell,
+                               1 + N * N + row * N + d,
+                               1 + 2 * N * N + col * N + d,
+                               1 + 3 * N * N + boxOf<B>(row, col) * N + d};
+                int first = nodes;
+                for (int k = 0; k < 4; k++)
+                {
+                    int n = nodes++;
+                    int c = cols[k];
+                    column[n] = c;
+                    candidate[n] = cell * N + d;
+                    up[n] = up[c];
+                    down[n] = c;
+                    down[up[c]] = n;
+                    up[c] = n;
+                    size[c]++;
+                    left[n] = (k == 0) ? n : n - 1;
+                    right[n] = first;
+                    right[left[n]] = n;
+                    left[first] = n;
+                }
+            }
+        }
+        // only the constraints not yet satisfied on the board are linked to the root
+        int last = 0;
+        for (int c = 1; c <= DLX_COLUMNS; c++)
+        {
+            int k = (c - 1) / (N * N), unit = (c - 1) % (N * N) / N;
+            typename BoardT<B>::Mask bit = (typename BoardT<B>::Mask)1 << ((c - 1) % N);
+            bool open;
+            if (k == 0)
+                open = grid.value[c - 1] == UNASSIGNED;
+            else if (k == 1)
+                open = !(grid.rows[unit] & bit);
+            else if (k == 2)
+                open = !(grid.cols[unit] & bit);
+            else
+                open = !(grid.boxes[unit] & bit);
+            if (open)
+            {
+                right[last] = c;
+                left[c] = last;
+                last = c;
+            }
+        }
+        right[last] = 0;
+        left[0] = last;
+    }
+
+    void cover(int c)
+    {
+        right[left[c]] = right[c];
+        left[right[c]] = left[c];
+        for (int i = down[c]; i != c; i = down[i])
+            for (int j = right[i]; j != i; j = right[j])
+            {
+                down[up[j]] = down[j];
+                up[down[j]] = up[j];
+                size[column[j]]--;
+            }
+    }
+
+    void uncover(int c)
+    {
+        for (int i = up[c]; i != c; i = up[i])
+            for (int j = left[i]; j != i; j = left[j])
+            {
+                size[column[j]]++;
+                down[up[j]] = j;
+                up[down[j]] = j;
+            }
+        right[left[c]] = c;
+        left[right[c]] = c;
+    }
+
+    bool search(int depth)
+    {
+        STAT_ADD(STAT_NODES, 1);
+        expanded++;
+        if (token && token->poll(countdown))
+            return false;
+        if (right[0] == 0)
+        {
+            solution[depth] = -1;
+            return counter == nullptr || counter->found();
+        }
+        // choose the column with fewest rows, as MRV does for cells
+        int best = right[0];
+        for (int c = right[best]; c != 0 && size[best] > 1; c = right[c])
+            if (size[c] < size[best])
+                best = c;
+        if (size[best] == 0)
+            return false;
+        cover(best);
+        for (int r = down[best]; r != best; r = down[r])
+        {
+            solution[depth] = candidate[r];
+            for (int j = right[r]; j != r; j = right[j])
+                cover(column[j]);
+            bool found = search(depth + 1);
+            for (int j = left[r]; j != r; j = left[j])
+                uncover(column[j]);
+            if (found)
+                return true;
+            STAT_ADD(STAT_BACKTRACKS, 1);
+        }
+        uncover(best);
+        return false;
+    }
+};
+
+/* Solves the board with Dancing Links, filling it in place on success.  */
+/* The search gives up (returning false) as soon as token is cancelled.  */
+/* With a counter that is counting, every solution is recorded in it and */
+/* the board is filled only with the one that reaches its limit. The     */
+/* nodes expanded are added to nodes, if given.                          */
+template <int B>
+bool solveDLX(BoardT<B> &grid, const CancelToken *token = nullptr, SolutionCounter *counter = nullptr,
+              long *nodes = nullptr)
+{
+    constexpr int N = B * B;
+    DLX<B> *dlx = new DLX<B>();
+    dlx->token = token;
+    if (counter != nullptr && counter->counting())
+        dlx->counter = counter;
+    dlx->build(grid);
+    bool found = dlx->search(0);
+    if (found)
+        for (int i = 0; dlx->solution[i] >= 0; i++)
+        {
+            int cell = dlx->solution[i] / N;
+            setValue(grid, cell / N, cell % N, dlx->solution[i] % N + 1);
+        }
+    if (nodes != nullptr)
+        *nodes += dlx->expanded;
+    delete dlx;
+    if (found)
+        calculatePossibleValues(grid);
+    return found;
+}
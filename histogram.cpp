@@ -0,0 +1,49 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements a histogram of latencies (in usecs) of fixed size, for the   */
+/* programs that report their percentiles however many they are. The latencies go    */
+/* in buckets of 1/64 of their power of two: exact below 64 usecs, within 1.6%       */
+/* above, in a few thousand counters. It is not synchronized, the callers lock it.   */
+
+#include <algorithm>
+
+struct LatencyHistogram
+{
+    static constexpr int SUB = 64;
+    long counts[SUB * 60] = {};
+    long total = 0, max = 0;
+
+    static int bucket(long v)
+    {
+        if (v < SUB)
+            return v;
+        int shift = 63 - __builtin_clzl(v) - 6;
+        return SUB * (shift + 1) + (v >> shift) - SUB;
+    }
+
+    // the smallest latency of the bucket
+    static long value(int b) { return b < SUB ? b : (long)(b % SUB + SUB) << (b / SUB - 1); }
+
+    void add(long v)
+    {
+        counts[bucket(v)]++;
+        total++;
+        max = std::max(max, v);
+    }
+
+    // the latency with p*total of them below it, as the element of a sorted array would be
+    long percentile(double p) const
+    {
+        long rank = std::min(total - 1, (long)(p * total)), seen = 0;
+        for (int b = 0; b < SUB * 60; b++)
+            if ((seen += counts[b]) > rank)
+                return value(b);
+        return 0;
+    }
+};
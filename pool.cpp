@@ -0,0 +1,182 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements a fixed-size fork/join thread pool.                        */
+/* Every worker owns a work-stealing deque (deque.cpp, include that first): tasks  */
+/* spawned by a worker go in its own deque, tasks spawned by any other thread go   */
+/* in a shared injection queue. A thread waiting for a group of tasks (wait) does  */
+/* not block, it keeps running tasks (its own first, then stolen ones) until the   */
+/* whole group is done, so a wait never leaves a core idle and nested fork/join    */
+/* does not need one thread per level.                                             */
+/* For a pool shared by unrelated jobs, join only runs the tasks of the caller's   */
+/* own deque, the ones it spawned and their subtasks, so a job never waits for     */
+/* another one it picked up.                                                       */
+
+#include <functional>
+#include <condition_variable>
+#include <deque>
+
+/* Tasks spawned together and waited together */
+struct taskgroup
+{
+  std::atomic<long> pending{0};
+};
+
+class threadpool
+{
+private:
+  struct task
+  {
+    std::function<void()> body;
+    taskgroup *group;
+  };
+
+  int nw;
+  std::vector<wsdeque<task *>> deques;
+  std::vector<std::thread> threads;
+  std::atomic<bool> stop{false};
+
+  std::mutex inject_mutex;
+  std::deque<task *> injected;
+
+  // idle workers sleep here, spawners wake them only if someone is sleeping
+  std::mutex idle_mutex;
+  std::condition_variable idle_condition;
+  std::atomic<int> sleeping{0};
+
+  // id of the calling thread in the pool it works for, -1 outside of any pool
+  static int &my_id()
+  {
+    static thread_local int id = -1;
+    return id;
+  }
+
+  bool take(task *&t, unsigned &seed)
+  {
+    int id = my_id();
+    if (id >= 0 && deques[id].pop(t))
+    {
+      STAT_ADD(STAT_POPPED, 1);
+      return true;
+    }
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    int victim = seed % nw;
+    for (int i = 0; i < nw; i++, victim = (victim + 1) % nw)
+      if (victim != id && deques[victim].steal(t))
+      {
+        STAT_ADD(STAT_STOLEN, 1);
+        return true;
+      }
+    std::unique_lock<std::mutex> lock(inject_mutex);
+    if (injected.empty())
+      return false;
+    t = injected.front();
+    injected.pop_front();
+    STAT_ADD(STAT_POPPED, 1);
+    return true;
+  }
+
+  void run(task *t)
+  {
+    t->body();
+    t->group->pending.fetch_sub(1);
+    delete t;
+  }
+
+  void workerBody(int id, std::function<void(int)> init)
+  {
+    my_id() = id;
+    if (init)
+      init(id);
+    unsigned seed = id + 1;
+    task *t;
+    while (!stop)
+    {
+      if (take(t, seed))
+        run(t);
+      else
+      {
+        STAT_START(idle);
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        sleeping++;
+        idle_condition.wait_for(lock, std::chrono::milliseconds(1));
+        sleeping--;
+        STAT_STOP(STAT_IDLE, idle);
+      }
+    }
+  }
+
+public:
+  // init runs first in every worker, with its id (e.g. to pin it to a cpu)
+  threadpool(int nw = std::thread::hardware_concurrency(), std::function<void(int)> init = nullptr)
+      : nw(nw > 0 ? nw : 1), deques(this->nw)
+  {
+    for (int i = 0; i < this->nw; i++)
+      threads.push_back(std::thread(&threadpool::workerBody, this, i, init));
+  }
+
+  ~threadpool()
+  {
+    stop = true;
+    idle_condition.notify_all();
+    for (std::thread &t : threads)
+      t.join();
+  }
+
+  int size() { return nw; }
+
+  // id in [0, size()) of the worker calling, -1 for a thread that is not a worker
+  static int id() { return my_id(); }
+
+  void spawn(taskgroup &group, std::function<void()> body)
+  {
+    group.pending.fetch_add(1);
+    STAT_ADD(STAT_PUSHED, 1);
+    task *t = new task{std::move(body), &group};
+    int id = my_id();
+    if (id >= 0)
+      deques[id].push(t);
+    else
+    {
+      std::unique_lock<std::mutex> lock(inject_mutex);
+      injected.push_back(t);
+    }
+    if (sleeping > 0)
+      idle_condition.notify_one();
+  }
+
+  // helping join: runs pending tasks until every task of the group is done
+  void wait(taskgroup &group)
+  {
+    unsigned seed = my_id() + 2;
+    task *t;
+    while (group.pending.load() > 0)
+      if (take(t, seed))
+        run(t);
+      else
+        std::this_thread::yield();
+  }
+
+  // join that only runs the tasks of the caller's own deque until every task of the
+  // group is done; once the others have taken the rest, it yields instead of stealing
+  void join(taskgroup &group)
+  {
+    int id = my_id();
+    task *t;
+    while (group.pending.load() > 0)
+      if (id >= 0 && deques[id].pop(t))
+      {
+        STAT_ADD(STAT_POPPED, 1);
+        run(t);
+      }
+      else
+        std::this_thread::yield();
+  }
+};
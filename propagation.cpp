@@ -0,0 +1,324 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements the constraint propagation stage run at every node of the  */
+/* search tree. Every rule can be switched on and off (see parseRules), and the    */
+/* enabled rules are applied until none of them changes the board anymore.        */
+/* It relies on the Board and Trail primitives of utils.cpp, include that first.   */
+
+#define RULE_NAKED_SINGLES  (1 << 0)
+#define RULE_HIDDEN_SINGLES (1 << 1)
+#define RULE_NAKED_PAIRS    (1 << 2)
+#define RULE_HIDDEN_PAIRS   (1 << 3)
+#define RULE_NAKED_TRIPLES  (1 << 4)
+#define RULE_HIDDEN_TRIPLES (1 << 5)
+#define RULE_POINTING       (1 << 6)
+
+#define RULES_ALL ((1 << 7) - 1)
+/* Pairs and triples prune few nodes for the time their scans take at every node, */
+/* so they are only applied when asked for                                         */
+#define RULES_DEFAULT (RULE_NAKED_SINGLES | RULE_HIDDEN_SINGLES | RULE_POINTING)
+
+/* Rules applied by propagate, set from the command line */
+int rules = RULES_DEFAULT;
+
+/* Cells of every row (0..N-1), column (N..2N-1) and box (2N..3N-1), computed at compile time */
+template <int B>
+struct UnitTable
+{
+    static constexpr int N = B * B;
+    int units[3 * N][N];
+
+    constexpr UnitTable() : units()
+    {
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
+            {
+                units[i][j] = i * N + j;
+                units[N + i][j] = j * N + i;
+                units[2 * N + i][j] = ((i / B) * B + j / B) * N + (i % B) * B + j % B;
+            }
+    }
+};
+
+template <int B>
+constexpr UnitTable<B> unitTable{};
+
+/* Parses a comma separated list of rule names (ns, hs, np, hp, nt, ht, pt), */
+/* "all" or "none". Returns -1 if the list contains an unknown name.         */
+int parseRules(const char *list)
+{
+    static const char *names[] = {"ns", "hs", "np", "hp", "nt", "ht", "pt"};
+    int parsed = 0;
+    std::string s(list);
+    size_t start = 0;
+    while (start <= s.size())
+    {
+        size_t end = s.find(',', start);
+        if (end == string::npos)
+            end = s.size();
+        std::string name = s.substr(start, end - start);
+        if (name == "all")
+            parsed |= RULES_ALL;
+        else if (name != "none")
+        {
+            int r = 0;
+            while (r < 7 && name != names[r])
+                r++;
+            if (r == 7)
+                return -1;
+            parsed |= 1 << r;
+        }
+        start = end + 1;
+    }
+    return parsed;
+}
+
+template <int B>
+static inline bool inUnit(int cell, int unit)
+{
+    constexpr int N = B * B;
+    if (unit < N)
+        return cell / N == unit;
+    if (unit < 2 * N)
+        return cell % N == unit - N;
+    return boxOf<B>(cell / N, cell % N) == unit - 2 * N;
+}
+
+template <int B>
+static inline typename BoardT<B>::Mask unitUsed(const BoardT<B> &grid, int unit)
+{
+    constexpr int N = B * B;
+    if (unit < N)
+        return grid.rows[unit];
+    if (unit < 2 * N)
+        return grid.cols[unit - N];
+    return grid.boxes[unit - 2 * N];
+}
+
+/* Every digit of every unit must be either placed or still possible somewhere */
+template <int B>
+static bool unitsConsistent(const BoardT<B> &grid)
+{
+    constexpr int N = B * B;
+    for (int u = 0; u < 3 * N; u++)
+    {
+        typename BoardT<B>::Mask seen = unitUsed(grid, u);
+        for (int cell : unitTable<B>.units[u])
+            seen |= grid.candidates[cell];
+        if (seen != BoardT<B>::FULL_MASK)
+            return false;
+    }
+    return true;
+}
+
+template <int B>
+static bool nakedSingles(BoardT<B> &grid, TrailT<B> *trail, bool &changed)
+{
+    constexpr int N = B * B;
+    for (int i = 0; i < N * N; i++)
+        if (grid.value[i] == UNASSIGNED)
+        {
+            typename BoardT<B>::Mask mask = grid.candidates[i];
+            if (mask == 0)
+                return false;
+            if ((mask & (mask - 1)) == 0)
+            {
+                changed = true;
+                if (!assign(grid, i / N, i % N, __builtin_ctz(mask) + 1, trail))
+                    return false;
+            }
+        }
+    return true;
+}
+
+template <int B>
+static bool hiddenSingles(BoardT<B> &grid, TrailT<B> *trail, bool &changed)
+{
+    constexpr int N = B * B;
+    typedef typename BoardT<B>::Mask Mask;
+    for (int u = 0; u < 3 * N; u++)
+    {
+        Mask once = 0, twice = 0;
+        for (int cell : unitTable<B>.units[u])
+        {
+            twice |= once & grid.candidates[cell];
+            once |= grid.candidates[cell];
+        }
+        if ((once | unitUsed(grid, u)) != BoardT<B>::FULL_MASK)
+            return false;
+        Mask singles = once & ~twice;
+        while (singles)
+        {
+            Mask bit = singles & -singles;
+            singles &= singles - 1;
+            for (int cell : unitTable<B>.units[u])
+                if (grid.candidates[cell] & bit)
+                {
+                    changed = true;
+                    if (!assign(grid, cell / N, cell % N, __builtin_ctz(bit) + 1, trail))
+                        return false;
+                    break;
+                }
+        }
+    }
+    return true;
+}
+
+/* k cells of a unit whose candidates are k digits in total: */
+/* no other cell of the unit can take those digits.          */
+template <int B>
+static bool nakedSubsets(BoardT<B> &grid, TrailT<B> *trail, bool &changed, int k)
+{
+    constexpr int N = B * B;
+    for (int u = 0; u < 3 * N; u++)
+    {
+        int cells[N], n = 0;
+        for (int cell : unitTable<B>.units[u])
+        {
+            int size = __builtin_popcount(grid.candidates[cell]);
+            if (size >= 2 && size <= k)
+                cells[n++] = cell;
+        }
+        // for pairs the third index just repeats the second one
+        for (int a = 0; a < n; a++)
+            for (int b = a + 1; b < n; b++)
+                for (int c = (k == 3 ? b + 1 : b); c < (k == 3 ? n : b + 1); c++)
+                {
+                    typename BoardT<B>::Mask subset = grid.candidates[cells[a]] | grid.candidates[cells[b]] | grid.candidates[cells[c]];
+                    int size = __builtin_popcount(subset);
+                    if (size < k)
+                        return false;
+                    if (size > k)
+                        continue;
+                    for (int cell : unitTable<B>.units[u])
+                        if (cell != cells[a] && cell != cells[b] && cell != cells[c] &&
+                            !eliminate(grid, cell, subset, trail, changed))
+                            return false;
+                }
+    }
+    return true;
+}
+
+/* k digits of a unit that fit only in the same k cells: */
+/* those cells cannot take any other digit.              */
+template <int B>
+static bool hiddenSubsets(BoardT<B> &grid, TrailT<B> *trail, bool &changed, int k)
+{
+    constexpr int N = B * B;
+    typedef typename BoardT<B>::Mask Mask;
+    const int (&units)[3 * N][N] = unitTable<B>.units;
+    for (int u = 0; u < 3 * N; u++)
+    {
+        Mask positions[N];
+        int digits[N], n = 0;
+        for (int d = 0; d < N; d++)
+        {
+            positions[d] = 0;
+            for (int j = 0; j < N; j++)
+                if (grid.candidates[units[u][j]] & ((Mask)1 << d))
+                    positions[d] |= (Mask)1 << j;
+            int size = __builtin_popcount(positions[d]);
+            if (size >= 2 && size <= k)
+                digits[n++] = d;
+        }
+        // for pairs the third index just repeats the second one
+        for (int a = 0; a < n; a++)
+            for (int b = a + 1; b < n; b++)
+                for (int c = (k == 3 ? b + 1 : b); c < (k == 3 ? n : b + 1); c++)
+                {
+                    Mask where = positions[digits[a]] | positions[digits[b]] | positions[digits[c]];
+                    Mask subset = ((Mask)1 << digits[a]) | ((Mask)1 << digits[b]) | ((Mask)1 << digits[c]);
+                    int size = __builtin_popcount(where);
+                    if (size < k)
+                        return false;
+                    if (size > k)
+                        continue;
+                    for (int j = 0; j < N; j++)
+                        if ((where & ((Mask)1 << j)) &&
+                            !eliminate(grid, units[u][j], BoardT<B>::FULL_MASK & ~subset, trail, changed))
+                            return false;
+                }
+    }
+    return true;
+}
+
+/* A digit confined to one row or column inside a box can be removed from the */
+/* rest of that row or column, and a digit confined to one box inside a row or */
+/* column can be removed from the rest of that box.                            */
+template <int B>
+static bool pointing(BoardT<B> &grid, TrailT<B> *trail, bool &changed)
+{
+    constexpr int N = B * B;
+    typedef typename BoardT<B>::Mask Mask;
+    for (int u = 0; u < 3 * N; u++)
+        for (int d = 0; d < N; d++)
+        {
+            Mask bit = (Mask)1 << d;
+            int rowsSeen = 0, colsSeen = 0, boxesSeen = 0, first = -1;
+            for (int cell : unitTable<B>.units[u])
+                if (grid.candidates[cell] & bit)
+                {
+                    rowsSeen |= 1 << (cell / N);
+                    colsSeen |= 1 << (cell % N);
+                    boxesSeen |= 1 << boxOf<B>(cell / N, cell % N);
+                    first = cell;
+                }
+            if (first < 0)
+                continue;
+            int target = -1;
+            if (u >= 2 * N && (rowsSeen & (rowsSeen - 1)) == 0)
+                target = first / N;
+            else if (u >= 2 * N && (colsSeen & (colsSeen - 1)) == 0)
+                target = N + first % N;
+            else if (u < 2 * N && (boxesSeen & (boxesSeen - 1)) == 0)
+                target = 2 * N + boxOf<B>(first / N, first % N);
+            if (target < 0)
+                continue;
+            for (int cell : unitTable<B>.units[target])
+                if (!inUnit<B>(cell, u) && !eliminate(grid, cell, bit, trail, changed))
+                    return false;
+        }
+    return true;
+}
+
+/* Applies the enabled rules until a fixpoint, logging the changes in the trail */
+/* (if any). Returns false if the board turned out to have no solution.         */
+template <int B>
+bool propagate(BoardT<B> &grid, TrailT<B> *trail = nullptr)
+{
+    STAT_ADD(STAT_PROPAGATIONS, 1);
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        if ((rules & RULE_NAKED_SINGLES) && !nakedSingles(grid, trail, changed))
+            return false;
+        if (changed)
+            continue;
+        if ((rules & RULE_HIDDEN_SINGLES) && !hiddenSingles(grid, trail, changed))
+            return false;
+        if (changed)
+            continue;
+        if ((rules & RULE_POINTING) && !pointing(grid, trail, changed))
+            return false;
+        if (changed)
+            continue;
+        if ((rules & RULE_NAKED_PAIRS) && !nakedSubsets(grid, trail, changed, 2))
+            return false;
+        if ((rules & RULE_HIDDEN_PAIRS) && !hiddenSubsets(grid, trail, changed, 2))
+            return false;
+        if (changed)
+            continue;
+        if ((rules & RULE_NAKED_TRIPLES) && !nakedSubsets(grid, trail, changed, 3))
+            return false;
+        if ((rules & RULE_HIDDEN_TRIPLES) && !hiddenSubsets(grid, trail, changed, 3))
+            return false;
+    }
+    return unitsConsistent(grid);
+}
@@ -11,6 +11,7 @@
 */
 
 #include <iostream>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
@@ -49,11 +50,246 @@ public:
   T pop()
   {
     std::unique_lock<std::mutex> lock(this->d_mutex);
+    STAT_START(idle);
     this->d_condition.wait(lock, [=] { return !this->d_queue.empty(); });
+    STAT_STOP(STAT_IDLE, idle);
     T rc(std::move(this->d_queue.back()));
     this->d_queue.pop_back();
     return rc;
   }
+
+  // never full
+  bool full() { return false; }
+
+  // never full, so it always succeeds
+  bool try_push(T const &value)
+  {
+    push(value);
+    return true;
+  }
+
+  // pushes all the values with one lock, returns how many (all of them)
+  template <typename It>
+  size_t push_many(It first, It last)
+  {
+    {
+      std::unique_lock<std::mutex> lock(this->d_mutex);
+      for (It it = first; it != last; ++it)
+        d_queue.push_front(*it);
+    }
+    this->d_condition.notify_all();
+    return last - first;
+  }
+};
+
+/* Bounded lock-free queue for many producers and many consumers, with the same   */
+/* interface of syque (D. Vyukov's ring buffer). Every slot has its own cache line */
+/* and a sequence number telling whether it is free or full for the current lap,  */
+/* so a push or a pop is one CAS on the position and no lock is taken. A thread    */
+/* that finds the queue empty (or full) spins for a while, then sleeps on a        */
+/* condition variable until a pop (or push) wakes it; the others only pay a load   */
+/* to see that nobody is sleeping.                                                 */
+template <typename T>
+class mpmcque
+{
+private:
+  struct alignas(64) cell
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static constexpr int SPIN = 1024;
+
+  cell *buffer;
+  size_t mask;
+  // next position to push and to pop, on different lines
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+
+  alignas(64) std::mutex park_mutex;
+  std::condition_variable not_empty, not_full;
+  std::atomic<int> parked_consumers{0}, parked_producers{0};
+
+  static void relax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  bool put(T const &value)
+  {
+    size_t pos = head.load(std::memory_order_relaxed);
+    while (true)
+    {
+      cell &c = buffer[pos & mask];
+      intptr_t diff = (intptr_t)c.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+      if (diff == 0)
+      {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          c.value = value;
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  bool take(T &value)
+  {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+      cell &c = buffer[pos & mask];
+      intptr_t diff = (intptr_t)c.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+      if (diff == 0)
+      {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          value = std::move(c.value);
+          c.sequence.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  // the fence pairs with the one of a thread going to sleep: either it sees the
+  // change made before, or this thread sees it parked
+  void wake(std::atomic<int> &parked, std::condition_variable &condition, bool all)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed) == 0)
+      return;
+    std::unique_lock<std::mutex> lock(park_mutex);
+    if (all)
+      condition.notify_all();
+    else
+      condition.notify_one();
+  }
+
+public:
+  // capacity is rounded up to a power of two
+  mpmcque(size_t capacity = 65536)
+  {
+    size_t size = 2;
+    while (size < capacity)
+      size *= 2;
+    buffer = new cell[size];
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+      buffer[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  ~mpmcque() { delete[] buffer; }
+
+  bool try_push(T const &value)
+  {
+    if (!put(value))
+      return false;
+    wake(parked_consumers, not_empty, false);
+    return true;
+  }
+
+  // approximate, true if a push would fail now: the slot at head is still full
+  bool full()
+  {
+    size_t pos = head.load(std::memory_order_relaxed);
+    return (intptr_t)buffer[pos & mask].sequence.load(std::memory_order_acquire) - (intptr_t)pos < 0;
+  }
+
+  bool try_pop(T &value)
+  {
+    if (!take(value))
+      return false;
+    wake(parked_producers, not_full, false);
+    return true;
+  }
+
+  // waits while the queue is full
+  void push(T const &value)
+  {
+    for (int i = 0; i < SPIN; i++)
+      if (try_push(value))
+        return;
+      else
+        relax();
+    {
+      std::unique_lock<std::mutex> lock(park_mutex);
+      parked_producers.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!put(value))
+        not_full.wait(lock);
+      parked_producers.fetch_sub(1);
+    }
+    wake(parked_consumers, not_empty, false);
+  }
+
+  // waits while the queue is empty
+  T pop()
+  {
+    T value;
+    for (int i = 0; i < SPIN; i++)
+      if (try_pop(value))
+        return value;
+      else
+        relax();
+    {
+      STAT_START(idle);
+      std::unique_lock<std::mutex> lock(park_mutex);
+      parked_consumers.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!take(value))
+        not_empty.wait(lock);
+      parked_consumers.fetch_sub(1);
+      STAT_STOP(STAT_IDLE, idle);
+    }
+    wake(parked_producers, not_full, false);
+    return value;
+  }
+
+  // pushes the values that fit, without waiting, claiming runs of free slots with
+  // one CAS each; returns how many were pushed, the first ones
+  template <typename It>
+  size_t push_many(It first, It last)
+  {
+    size_t n = last - first, done = 0;
+    while (done < n)
+    {
+      size_t pos = head.load(std::memory_order_relaxed), k = 0;
+      while (k < n - done && buffer[(pos + k) & mask].sequence.load(std::memory_order_acquire) == pos + k)
+        k++;
+      if (k == 0)
+      {
+        if ((intptr_t)buffer[pos & mask].sequence.load(std::memory_order_acquire) - (intptr_t)pos < 0)
+          break;
+        continue;
+      }
+      // a slot found free stays free until the producer that moves head past it fills it
+      if (!head.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+        continue;
+      for (size_t i = 0; i < k; i++)
+      {
+        cell &c = buffer[(pos + i) & mask];
+        c.value = first[done + i];
+        c.sequence.store(pos + i + 1, std::memory_order_release);
+      }
+      done += k;
+    }
+    if (done > 0)
+      wake(parked_consumers, not_empty, done > 1);
+    return done;
+  }
 };
 
 // loose some time
@@ -0,0 +1,193 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements the backtracking search shared by the programs, as a loop   */
+/* over an explicit stack instead of a recursion per placement. A frame only keeps  */
+/* the cell branched on, the candidates not tried yet and the size of the trail     */
+/* before the branch: the board is changed in place and rolled back through the     */
+/* trail, so going back to a frame is an undo and a new frame costs a few bytes.    */
+/* A path places at most one digit per cell, so N*N frames always suffice and the   */
+/* depth of the tree is never limited by the size of the thread stack.              */
+/* The frames at the bottom of the stack are the biggest subtrees not explored yet: */
+/* donate hands out the candidates left in the lowest one, with the board they      */
+/* start from, for a parallel program to give them to another thread.               */
+/* It relies on the Board and Trail primitives of utils.cpp and on propagate        */
+/* (propagation.cpp), include those first.                                          */
+
+template <int B>
+struct FrameT
+{
+    uint16_t cell;
+    typename BoardT<B>::Mask remaining;
+    // trail size before the branch being explored, the board of the frame
+    int mark;
+};
+
+template <int B>
+struct SearchStackT
+{
+    static constexpr int N = B * B;
+    FrameT<B> frames[N * N];
+    int size = 0;
+    // trail size when the search started
+    int mark = 0;
+};
+
+/* Branching of the search: the cell with the fewest candidates (the first one on */
+/* ties), its candidates in increasing order. Another branching is any type with  */
+/* the same two methods.                                                          */
+template <int B>
+struct MinimumBranching
+{
+    // false if the board is full
+    bool cell(const BoardT<B> &grid, int &cell)
+    {
+        int row, col;
+        if (!FindUnassignedMinimumLocation(grid, row, col))
+            return false;
+        cell = row * B * B + col;
+        return true;
+    }
+
+    // the next candidate to try among remaining, on the board of its frame
+    int value(const BoardT<B> & /*grid*/, int /*cell*/, typename BoardT<B>::Mask remaining)
+    {
+        return __builtin_ctz(remaining) + 1;
+    }
+};
+
+/* Searches the board, already propagated, on the given stack. Every node asks     */
+/* stop() first, and gives up if it is true. A full board is passed to leaf(),     */
+/* which returns true to end the search there (the board is left as the solution)  */
+/* or false to keep looking, e.g. when the solutions are being counted.            */
+/* Returns false if the search ended without a solution, with the board as it was. */
+template <int B, typename Leaf, typename Stop, typename Branching>
+bool search(BoardT<B> &grid, TrailT<B> &trail, SearchStackT<B> &stack, Leaf leaf, Stop stop, Branching &branching)
+{
+    constexpr int N = B * B;
+    stack.size = 0;
+    stack.mark = trail.size;
+    while (true)
+    {
+        // a new node: the board after the last placement
+        STAT_ADD(STAT_NODES, 1);
+        if (stop())
+        {
+            undo(grid, trail, stack.mark);
+            stack.size = 0;
+            return false;
+        }
+        int cell = 0;
+        bool failed = false;
+        if (branching.cell(grid, cell))
+            stack.frames[stack.size++] = {(uint16_t)cell, grid.candidates[cell], trail.size};
+        else if (leaf(grid))
+        {
+            stack.size = 0;
+            return true;
+        }
+        else
+            failed = true;
+        // the next branch of the deepest frame that has one left
+        bool descended = false;
+        while (!descended && stack.size > 0)
+        {
+            FrameT<B> &f = stack.frames[stack.size - 1];
+            if (failed)
+            {
+                STAT_ADD(STAT_BACKTRACKS, 1);
+            }
+            undo(grid, trail, f.mark);
+            if (f.remaining == 0)
+            {
+                stack.size--;
+                failed = true;
+                continue;
+            }
+            int num = branching.value(grid, f.cell, f.remaining);
+            f.remaining &= ~DIGIT_BIT(num);
+            descended = assign(grid, f.cell / N, f.cell % N, num, &trail) && propagate(grid, &trail);
+            failed = !descended;
+        }
+        if (!descended)
+            return false;
+    }
+}
+
+template <int B, typename Leaf, typename Stop>
+bool search(BoardT<B> &grid, TrailT<B> &trail, SearchStackT<B> &stack, Leaf leaf, Stop stop)
+{
+    MinimumBranching<B> branching;
+    return search(grid, trail, stack, leaf, stop, branching);
+}
+
+/* Replays the changes logged in the trail from position from to position to on a */
+/* board that was at from, the opposite of undo.                                  */
+template <int B>
+void redo(BoardT<B> &grid, const TrailT<B> &trail, int from, int to)
+{
+    constexpr int N = B * B;
+    for (int i = from; i < to; i++)
+    {
+        const TrailEntry<B> &e = trail.entries[i];
+        if (e.num != 0)
+            setValue(grid, e.cell / N, e.cell % N, e.num);
+        else
+            grid.candidates[e.cell] &= ~e.removed;
+    }
+}
+
+/* True if some frame still has candidates not tried yet, i.e. donate would give */
+/* something; it costs no copy of a board.                                       */
+template <int B>
+bool canDonate(const SearchStackT<B> &stack)
+{
+    for (int i = 0; i < stack.size; i++)
+        if (stack.frames[i].remaining != 0)
+            return true;
+    return false;
+}
+
+/* Takes out of the search the candidates not tried yet of its lowest frame that has */
+/* some, to be explored elsewhere: board becomes the board of that frame, rebuilt    */
+/* from start (the board the search started from), and cell and candidates what is   */
+/* left to branch on. Returns false if there is nothing left to give. It must be     */
+/* called by the thread running the search, from stop() or leaf().                   */
+template <int B>
+bool donate(const BoardT<B> &start, const TrailT<B> &trail, SearchStackT<B> &stack, BoardT<B> &board, int &cell,
+            typename BoardT<B>::Mask &candidates)
+{
+    for (int i = 0; i < stack.size; i++)
+    {
+        FrameT<B> &f = stack.frames[i];
+        if (f.remaining == 0)
+            continue;
+        board = start;
+        redo(board, trail, stack.mark, f.mark);
+        cell = f.cell;
+        candidates = f.remaining;
+        f.remaining = 0;
+        return true;
+    }
+    return false;
+}
+
+/* Gives back to the search the candidates of cell that donate took out of it, when */
+/* they could not be handed out: the search explores them itself.                   */
+template <int B>
+void undonate(SearchStackT<B> &stack, int cell, typename BoardT<B>::Mask candidates)
+{
+    for (int i = 0; i < stack.size; i++)
+        if (stack.frames[i].cell == cell)
+        {
+            stack.frames[i].remaining |= candidates;
+            return;
+        }
+}
+
+typedef SearchStackT<BOX_SIZE> SearchStack;
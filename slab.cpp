@@ -0,0 +1,106 @@
+/**
+ * Parallel and Distributed Systems: Paradigms and Models
+ * Year 2019/2020
+ * Final Project
+ * Paoletti Riccardo
+ * Student ID: 532143
+*/
+
+/* This file implements an allocator of objects of one type (e.g. boards) for a     */
+/* fixed set of threads, each one identified by an id in [0, nthreads).             */
+/* Every thread carves its objects out of its own chunks by bumping a pointer, and  */
+/* keeps the freed ones in a private free list, so allocating takes no lock. An     */
+/* object freed by another thread is given back to the thread that allocated it,    */
+/* through a lock-free list the owner empties in one exchange when its private list */
+/* runs out: memory never exceeds the peak of live objects of each thread, whatever */
+/* the pattern of allocations and frees among the threads.                          */
+
+#include <atomic>
+#include <new>
+#include <vector>
+
+template <typename T>
+class slab
+{
+private:
+  struct node
+  {
+    alignas(T) unsigned char storage[sizeof(T)];
+    node *next;
+    int owner;
+  };
+
+  struct alignas(64) local
+  {
+    node *free = nullptr;
+    node *bump = nullptr, *bump_end = nullptr;
+    std::vector<node *> chunks;
+    // objects of this thread freed by the others
+    alignas(64) std::atomic<node *> remote{nullptr};
+  };
+
+  int nthreads;
+  long chunk_size;
+  local *locals;
+
+  node *allocate(int tid)
+  {
+    local &l = locals[tid];
+    if (l.free == nullptr)
+      l.free = l.remote.exchange(nullptr, std::memory_order_acquire);
+    if (l.free != nullptr)
+    {
+      node *n = l.free;
+      l.free = n->next;
+      return n;
+    }
+    if (l.bump == l.bump_end)
+    {
+      l.bump = static_cast<node *>(::operator new(chunk_size * sizeof(node)));
+      l.bump_end = l.bump + chunk_size;
+      l.chunks.push_back(l.bump);
+    }
+    node *n = l.bump++;
+    n->owner = tid;
+    return n;
+  }
+
+  void deallocate(int tid, node *n)
+  {
+    if (n->owner == tid)
+    {
+      n->next = locals[tid].free;
+      locals[tid].free = n;
+      return;
+    }
+    std::atomic<node *> &remote = locals[n->owner].remote;
+    n->next = remote.load(std::memory_order_relaxed);
+    while (!remote.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed))
+      ;
+  }
+
+public:
+  slab(int nthreads, long chunk_size = 256) : nthreads(nthreads), chunk_size(chunk_size), locals(new local[nthreads]) {}
+
+  // objects still alive are released without being destroyed
+  ~slab()
+  {
+    for (int i = 0; i < nthreads; i++)
+      for (node *c : locals[i].chunks)
+        ::operator delete(c);
+    delete[] locals;
+  }
+
+  // a copy of value, owned by thread tid
+  T *create(int tid, const T &value)
+  {
+    return new (allocate(tid)->storage) T(value);
+  }
+
+  // tid is the thread calling, not necessarily the one that created p
+  void destroy(int tid, T *p)
+  {
+    p->~T();
+    deallocate(tid, reinterpret_cast<node *>(p));
+  }
+};
@@ -11,181 +11,1008 @@
 #include <iostream>
 #include <string>
 #include <mutex>
-#include <tgmath.h>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <fstream>
 #include <chrono>
 #include <utility>
 #include <thread>
 #include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 using namespace std;
 
 #define UNASSIGNED 0
 
-#define WORKING_ON -1
+/* Counters of the work done by the search, compiled in only with -DSTATS so that    */
+/* the normal builds pay nothing for them. Every thread counts in its own cache line */
+/* with plain increments (STAT_ADD), times are taken in nanoseconds between          */
+/* STAT_START and STAT_STOP; printStats sums the counters of all the threads at the  */
+/* end, showing also the least and most loaded thread.                               */
+enum Stat
+{
+    STAT_NODES,        // nodes of the search tree expanded
+    STAT_BACKTRACKS,   // branches that failed
+    STAT_CANDIDATES,   // full recomputations of the candidates of a board
+    STAT_PROPAGATIONS, // runs of the propagation rules
+    STAT_PUSHED,       // tasks created
+    STAT_POPPED,       // tasks taken by the thread that created them or from a queue
+    STAT_STOLEN,       // tasks taken from another thread
+    STAT_IDLE,         // time spent waiting for a task
+    STAT_EMITTER,      // time spent by the emitter forwarding tasks
+    STAT_MASTER,       // time spent by the master creating the first tasks
+    STAT_COUNT
+};
 
-#define N 9
+#ifdef STATS
+const char *stat_names[STAT_COUNT] = {"Search nodes", "Backtracks", "Candidate recomputations", "Propagations",
+                                      "Tasks pushed", "Tasks popped", "Tasks stolen",
+                                      "Idle time", "Emitter time", "Master time"};
 
-struct Cell
+struct alignas(64) ThreadStats
 {
-    int value = UNASSIGNED;
-    std::vector<int> possible_values;
+    long value[STAT_COUNT] = {};
 };
 
-bool UsedInRow(Cell** grid, int row, int num)
+class StatsRegistry
 {
-    for (int col = 0; col < N; col++)
-        if (grid[row][col].value == num)
-            return true;
-    return false;
+private:
+    std::mutex mutex;
+    std::vector<ThreadStats *> threads;
+
+public:
+    ThreadStats *add()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        threads.push_back(new ThreadStats());
+        return threads.back();
+    }
+
+    void print()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (int s = 0; s < STAT_COUNT; s++)
+        {
+            long total = 0, least = LONG_MAX, most = 0;
+            for (ThreadStats *t : threads)
+            {
+                total += t->value[s];
+                least = std::min(least, t->value[s]);
+                most = std::max(most, t->value[s]);
+            }
+            if (total == 0 && s != STAT_NODES)
+                continue;
+            bool time = s >= STAT_IDLE;
+            long scale = time ? 1000 : 1;
+            cout << stat_names[s] << " : " << total / scale << (time ? " usecs" : "")
+                 << " (per thread min " << least / scale << " max " << most / scale << ")" << endl;
+        }
+        cout << "Threads counting : " << threads.size() << endl;
+    }
+};
+
+StatsRegistry stats_registry;
+
+inline ThreadStats &myStats()
+{
+    static thread_local ThreadStats *stats = stats_registry.add();
+    return *stats;
 }
 
-bool UsedInCol(Cell** grid, int col, int num)
+#define STAT_ADD(stat, n) (myStats().value[stat] += (n))
+#define STAT_START(timer) auto timer = std::chrono::steady_clock::now()
+#define STAT_STOP(stat, timer) STAT_ADD(stat, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timer).count())
+
+void printStats() { stats_registry.print(); }
+#else
+#define STAT_ADD(stat, n)
+#define STAT_START(timer)
+#define STAT_STOP(stat, timer)
+
+void printStats() {}
+#endif
+
+/* Side of a box, chosen at compile time: 3 for 9x9 boards, 4 for 16x16, 5 for 25x25 */
+#ifndef BOX_SIZE
+#define BOX_SIZE 3
+#endif
+// largest side of a box: the candidates of a cell are a 32 bit mask
+#define MAX_BOX_SIZE 5
+static_assert(BOX_SIZE <= MAX_BOX_SIZE, "BOX_SIZE must not be above MAX_BOX_SIZE");
+
+/* Bit (num - 1) of a mask stands for digit num */
+#define DIGIT_BIT(num) (1u << ((num) - 1))
+
+/* Packed, fixed-size board: copying it is a plain struct copy.                 */
+/* rows/cols/boxes hold the digits already used in every unit, candidates holds */
+/* the digits still assignable to every cell (0 for the assigned ones).         */
+/* The geometry and the width of the masks are fixed by the side of a box B.    */
+template <int B>
+struct BoardT
 {
-    for (int row = 0; row < N; row++)
-        if (grid[row][col].value == num)
-            return true;
-    return false;
+    static constexpr int N = B * B;
+    // cells sharing a row, a column or a box with a given cell
+    static constexpr int NUM_PEERS = 3 * (N - 1) - 2 * (B - 1);
+    typedef typename std::conditional<(N <= 16), uint16_t, uint32_t>::type Mask;
+    static constexpr Mask FULL_MASK = (Mask)((1ull << N) - 1);
+
+    uint8_t value[N * N];
+    Mask rows[N];
+    Mask cols[N];
+    Mask boxes[N];
+    Mask candidates[N * N];
+};
+
+/* One undoable change: either the placement of num in cell (num != 0) */
+/* or the removal of the removed candidates from cell (num == 0).      */
+template <int B>
+struct TrailEntry
+{
+    uint16_t cell;
+    uint8_t num;
+    typename BoardT<B>::Mask removed;
+};
+
+/* Undo log of the search, rolled back to a mark when a branch fails */
+template <int B>
+struct TrailT
+{
+    static constexpr int N = B * B;
+    // every entry removes at least one candidate, plus one entry per placement
+    static constexpr int MAX_TRAIL = N * N * (N + 1);
+
+    TrailEntry<B> entries[MAX_TRAIL];
+    int size = 0;
+};
+
+template <int B>
+static constexpr inline int boxOf(int row, int col)
+{
+    return (row / B) * B + col / B;
 }
 
-bool UsedInBox(Cell** grid, int boxStartRow, int boxStartCol, int num)
+/* Peers of every cell, computed at compile time */
+template <int B>
+struct PeerTable
 {
-    for (int row = 0; row < sqrt(N); row++)
-        for (int col = 0; col < sqrt(N); col++)
-            if (grid[row + boxStartRow][col + boxStartCol].value == num)
-                return true;
-    return false;
+    static constexpr int N = B * B;
+    int peers[N * N][BoardT<B>::NUM_PEERS];
+
+    constexpr PeerTable() : peers()
+    {
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            int row = cell / N, col = cell % N, k = 0;
+            for (int other = 0; other < N * N; other++)
+            {
+                int r = other / N, c = other % N;
+                if (other != cell && (r == row || c == col || boxOf<B>(r, c) == boxOf<B>(row, col)))
+                    peers[cell][k++] = other;
+            }
+        }
+    }
+};
+
+template <int B>
+constexpr PeerTable<B> peerTable{};
+
+template <int B>
+bool UsedInRow(const BoardT<B> &grid, int row, int num)
+{
+    return grid.rows[row] & DIGIT_BIT(num);
+}
+
+template <int B>
+bool UsedInCol(const BoardT<B> &grid, int col, int num)
+{
+    return grid.cols[col] & DIGIT_BIT(num);
+}
+
+template <int B>
+bool UsedInBox(const BoardT<B> &grid, int box, int num)
+{
+    return grid.boxes[box] & DIGIT_BIT(num);
 }
 
-bool isSafe(Cell** grid, int row, int col, int num)
+template <int B>
+bool isSafe(const BoardT<B> &grid, int row, int col, int num)
 {
 
     return  !UsedInRow(grid, row, num) && 
             !UsedInCol(grid, col, num) && 
-            !UsedInBox(grid, row - row % ((int)sqrt(N)), col - col % ((int)sqrt(N)), num) &&
-            grid[row][col].value == UNASSIGNED;
+            !UsedInBox(grid, boxOf<B>(row, col), num) &&
+            grid.value[row * B * B + col] == UNASSIGNED;
 }
 
-void printGrid(Cell **grid)
+template <int B>
+void printGrid(const BoardT<B> &grid)
 {
+    constexpr int N = B * B;
     for (int row = 0; row < N; row++)
     {
         for (int col = 0; col < N; col++)
-            std::cout << grid[row][col].value << " ";
+            std::cout << (int)grid.value[row * N + col] << " ";
         std::cout << std::endl;
     }
     std::cout << std::endl;
     std::cout << std::endl;
 }
 
-void allocateGrid(int**&grid){
-    grid = new int *[N];
-    for (int i = 0; i < N; i++)
-        grid[i] = new int[N];
-}
-
-void readGrids(vector<int**>* &grids, string filename){
-    
-    ifstream file(filename);
-    if (file.is_open()) {
-        std::string line;
-        while (getline(file, line)) {
-            int** new_grid;
-            allocateGrid(new_grid);
-            size_t pos = 0;
-            std::string token;
-            int i=0, j=0;
-            while ((pos = line.find(" ")) != string::npos) {
-                token = line.substr(0, pos);
-            
-                new_grid[i][j] = atoi(token.c_str());
-                j++;
-                if(j==N){
-                    i++;
-                    j=0;
-                }
-
-                line.erase(0, pos + 1);
-            }
-            grids->push_back(new_grid);
-        }
-        file.close();
-    }
+template <int B>
+int countEmpty(const BoardT<B> &grid)
+{
+    constexpr int N = B * B;
+    int filled = 0;
+    for (int row = 0; row < N; row++)
+        filled += __builtin_popcount(grid.rows[row]);
+    return N * N - filled;
 }
 
-bool FindUnassignedMinimumLocation(Cell **grid, int &row, int &col)
+template <int B>
+bool FindUnassignedMinimumLocationScalar(const BoardT<B> &grid, int &row, int &col)
 {
+    constexpr int N = B * B;
     int min = N+1;
-    for (int i = 0; i < N; i++)
-        for (int j = 0; j < N; j++)
-            if (grid[i][j].value == UNASSIGNED){
-                int size = grid[i][j].possible_values.size();
-                if(size < min){
-                    min = size;
-                    row = i;
-                    col = j;
-                }
+    for (int i = 0; i < N * N; i++)
+        if (grid.value[i] == UNASSIGNED){
+            int size = __builtin_popcount(grid.candidates[i]);
+            if(size < min){
+                min = size;
+                row = i / N;
+                col = i % N;
             }
+        }
     
     return (min != N+1);
 }
 
-void calculatePossibleValues(Cell** grid){
+template <int B>
+void calculatePossibleValuesScalar(BoardT<B> &grid){
+    constexpr int N = B * B;
     for(int row=0;row<N;row++)
         for(int col=0;col<N;col++)
         {
-            grid[row][col].possible_values.clear();
-            for(int num=1;num<=N;num++)
-                if(isSafe(grid, row, col, num))
-                    grid[row][col].possible_values.push_back(num);
+            int i = row * N + col;
+            if(grid.value[i] == UNASSIGNED)
+                grid.candidates[i] = BoardT<B>::FULL_MASK & ~(grid.rows[row] | grid.cols[col] | grid.boxes[boxOf<B>(row, col)]);
+            else
+                grid.candidates[i] = 0;
         }
 }
 
-Cell** fillGrid(int** grid){
-    Cell** filledGrid = new Cell*[N];
-    for(int row=0;row<N;row++){
-        filledGrid[row] = new Cell[N];
-        for(int col=0;col<N;col++){
-            Cell c;
-            c.value = grid[row][col];
-            filledGrid[row][col] = c;
+/* Vectorized versions of the two functions above, for the boards whose masks are   */
+/* 16 bit wide (9x9 and 16x16), compiled for SSE4.1 and AVX2 and chosen at run time */
+/* according to the processor (simd_level). Build with -DNO_SIMD to leave them out. */
+#define SIMD_NONE 0
+#define SIMD_SSE41 1
+#define SIMD_AVX2 2
+
+#if defined(__x86_64__) && !defined(NO_SIMD)
+#define SIMD_KERNELS
+#include <immintrin.h>
+
+int detectSimd()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SIMD_SSE41;
+    return SIMD_NONE;
+}
+#else
+int detectSimd() { return SIMD_NONE; }
+#endif
+
+int simd_level = detectSimd();
+
+#ifdef SIMD_KERNELS
+/* The MRV cell is found by taking, in every lane, the minimum of                 */
+/* key = (candidates << 6) | chunk, assigned cells counting as N+1 candidates: the */
+/* first minimum over the lanes (_mm_minpos_epu16) is then the first cell with the */
+/* fewest candidates in board order, as in the scalar scan.                        */
+template <int B>
+__attribute__((target("sse4.1"))) bool FindUnassignedMinimumLocationSSE(const BoardT<B> &grid, int &row, int &col)
+{
+    constexpr int N = B * B;
+    const __m128i nibbles = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low = _mm_set1_epi8(0x0f), ones = _mm_set1_epi8(1), zero = _mm_setzero_si128();
+    const __m128i assigned_cost = _mm_set1_epi16(N + 1);
+    __m128i best = _mm_set1_epi16(-1);
+    int chunks = N * N / 8;
+    for (int k = 0; k < chunks; k++)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)(grid.candidates + k * 8));
+        __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(nibbles, _mm_and_si128(c, low)),
+                                     _mm_shuffle_epi8(nibbles, _mm_and_si128(_mm_srli_epi16(c, 4), low)));
+        __m128i count = _mm_maddubs_epi16(bytes, ones);
+        __m128i values = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(grid.value + k * 8)));
+        __m128i cost = _mm_blendv_epi8(assigned_cost, count, _mm_cmpeq_epi16(values, zero));
+        __m128i key = _mm_or_si128(_mm_slli_epi16(cost, 6), _mm_set1_epi16(k));
+        best = _mm_min_epu16(best, key);
+    }
+    int min = N + 1, cell = -1;
+    if (chunks > 0)
+    {
+        int result = _mm_cvtsi128_si32(_mm_minpos_epu16(best));
+        min = (result & 0xffff) >> 6;
+        cell = (result & 63) * 8 + (result >> 16);
+    }
+    for (int i = chunks * 8; i < N * N; i++)
+        if (grid.value[i] == UNASSIGNED && __builtin_popcount(grid.candidates[i]) < min)
+        {
+            min = __builtin_popcount(grid.candidates[i]);
+            cell = i;
         }
+    if (min == N + 1)
+        return false;
+    row = cell / N;
+    col = cell % N;
+    return true;
+}
+
+template <int B>
+__attribute__((target("avx2"))) bool FindUnassignedMinimumLocationAVX2(const BoardT<B> &grid, int &row, int &col)
+{
+    constexpr int N = B * B;
+    const __m256i nibbles = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f), ones = _mm256_set1_epi8(1), zero = _mm256_setzero_si256();
+    const __m256i assigned_cost = _mm256_set1_epi16(N + 1);
+    __m256i best = _mm256_set1_epi16(-1);
+    int chunks = N * N / 16;
+    for (int k = 0; k < chunks; k++)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(grid.candidates + k * 16));
+        __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(nibbles, _mm256_and_si256(c, low)),
+                                        _mm256_shuffle_epi8(nibbles, _mm256_and_si256(_mm256_srli_epi16(c, 4), low)));
+        __m256i count = _mm256_maddubs_epi16(bytes, ones);
+        __m256i values = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(grid.value + k * 16)));
+        __m256i cost = _mm256_blendv_epi8(assigned_cost, count, _mm256_cmpeq_epi16(values, zero));
+        __m256i key = _mm256_or_si256(_mm256_slli_epi16(cost, 6), _mm256_set1_epi16(k));
+        best = _mm256_min_epu16(best, key);
+    }
+    int min = N + 1, cell = -1;
+    if (chunks > 0)
+    {
+        // lanes 0-7 come before lanes 8-15 of the same chunk, so on a tie the low half wins
+        int lo = _mm_cvtsi128_si32(_mm_minpos_epu16(_mm256_castsi256_si128(best)));
+        int hi = _mm_cvtsi128_si32(_mm_minpos_epu16(_mm256_extracti128_si256(best, 1)));
+        int result = (hi & 0xffff) < (lo & 0xffff) ? hi + (8 << 16) : lo;
+        min = (result & 0xffff) >> 6;
+        cell = (result & 63) * 16 + (result >> 16);
+    }
+    for (int i = chunks * 16; i < N * N; i++)
+        if (grid.value[i] == UNASSIGNED && __builtin_popcount(grid.candidates[i]) < min)
+        {
+            min = __builtin_popcount(grid.candidates[i]);
+            cell = i;
+        }
+    if (min == N + 1)
+        return false;
+    row = cell / N;
+    col = cell % N;
+    return true;
+}
+
+/* Row by row: the row mask is broadcast, the column masks are loaded as they are  */
+/* and the box masks are spread over the columns of their box once per box row.     */
+template <int B>
+__attribute__((target("sse4.1"))) void calculatePossibleValuesSSE(BoardT<B> &grid)
+{
+    constexpr int N = B * B;
+    const __m128i full = _mm_set1_epi16(BoardT<B>::FULL_MASK), zero = _mm_setzero_si128();
+    uint16_t box_cols[N] = {};
+    for (int row = 0; row < N; row++)
+    {
+        if (row % B == 0)
+            for (int col = 0; col < N; col++)
+                box_cols[col] = grid.boxes[boxOf<B>(row, col)];
+        __m128i used_row = _mm_set1_epi16(grid.rows[row]);
+        int col = 0;
+        for (; col + 8 <= N; col += 8)
+        {
+            __m128i used = _mm_or_si128(used_row, _mm_or_si128(_mm_loadu_si128((const __m128i *)(grid.cols + col)),
+                                                                _mm_loadu_si128((const __m128i *)(box_cols + col))));
+            __m128i values = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(grid.value + row * N + col)));
+            __m128i free = _mm_cmpeq_epi16(values, zero);
+            _mm_storeu_si128((__m128i *)(grid.candidates + row * N + col), _mm_and_si128(_mm_andnot_si128(used, full), free));
+        }
+        // the columns left over by the vectors, none when they divide N
+        if constexpr (N % 8 != 0)
+            for (; col < N; col++)
+                grid.candidates[row * N + col] = grid.value[row * N + col] == UNASSIGNED ? BoardT<B>::FULL_MASK & ~(grid.rows[row] | grid.cols[col] | box_cols[col]) : 0;
     }
-    calculatePossibleValues(filledGrid);
-    return filledGrid;
 }
 
-void copyCell(Cell** source, Cell** &dest){
-    dest = new Cell *[N];
-    for (int r = 0; r < N; r++)
+template <int B>
+__attribute__((target("avx2"))) void calculatePossibleValuesAVX2(BoardT<B> &grid)
+{
+    constexpr int N = B * B;
+    const __m256i full = _mm256_set1_epi16(BoardT<B>::FULL_MASK), zero = _mm256_setzero_si256();
+    uint16_t box_cols[N] = {};
+    for (int row = 0; row < N; row++)
     {
-        dest[r] = new Cell[N];
-        for (int c = 0; c < N; c++)
-            if (source[r][c].value == WORKING_ON)
-                dest[r][c].value = UNASSIGNED;
+        if (row % B == 0)
+            for (int col = 0; col < N; col++)
+                box_cols[col] = grid.boxes[boxOf<B>(row, col)];
+        __m256i used_row = _mm256_set1_epi16(grid.rows[row]);
+        int col = 0;
+        for (; col + 16 <= N; col += 16)
+        {
+            __m256i used = _mm256_or_si256(used_row, _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(grid.cols + col)),
+                                                                     _mm256_loadu_si256((const __m256i *)(box_cols + col))));
+            __m256i values = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(grid.value + row * N + col)));
+            __m256i free = _mm256_cmpeq_epi16(values, zero);
+            _mm256_storeu_si256((__m256i *)(grid.candidates + row * N + col), _mm256_and_si256(_mm256_andnot_si256(used, full), free));
+        }
+        // the columns left over by the vectors, none when they divide N
+        if constexpr (N % 16 != 0)
+            for (; col < N; col++)
+                grid.candidates[row * N + col] = grid.value[row * N + col] == UNASSIGNED ? BoardT<B>::FULL_MASK & ~(grid.rows[row] | grid.cols[col] | box_cols[col]) : 0;
+    }
+}
+#endif
+
+template <int B>
+bool FindUnassignedMinimumLocation(const BoardT<B> &grid, int &row, int &col)
+{
+#ifdef SIMD_KERNELS
+    if constexpr (sizeof(typename BoardT<B>::Mask) == 2)
+    {
+        if (simd_level == SIMD_AVX2)
+            return FindUnassignedMinimumLocationAVX2(grid, row, col);
+        if (simd_level == SIMD_SSE41)
+            return FindUnassignedMinimumLocationSSE(grid, row, col);
+    }
+#endif
+    return FindUnassignedMinimumLocationScalar(grid, row, col);
+}
+
+template <int B>
+void calculatePossibleValues(BoardT<B> &grid)
+{
+    STAT_ADD(STAT_CANDIDATES, 1);
+#ifdef SIMD_KERNELS
+    if constexpr (sizeof(typename BoardT<B>::Mask) == 2)
+    {
+        // with 9 columns a row fits in one SSE vector, AVX2 would only add a tail
+        if (simd_level == SIMD_AVX2 && B * B >= 16)
+            return calculatePossibleValuesAVX2(grid);
+        if (simd_level >= SIMD_SSE41)
+            return calculatePossibleValuesSSE(grid);
+    }
+#endif
+    calculatePossibleValuesScalar(grid);
+}
+
+/* Assigns num to the cell and marks it as used in the cell's units.  */
+/* The candidates of the other cells are refreshed by the caller.     */
+template <int B>
+void setValue(BoardT<B> &grid, int row, int col, int num){
+    constexpr int N = B * B;
+    grid.value[row * N + col] = num;
+    grid.candidates[row * N + col] = 0;
+    grid.rows[row] |= DIGIT_BIT(num);
+    grid.cols[col] |= DIGIT_BIT(num);
+    grid.boxes[boxOf<B>(row, col)] |= DIGIT_BIT(num);
+}
+
+/* Places num in the cell and removes it from the candidates of its peers,     */
+/* logging every change in the trail (if any) so that undo can revert it.      */
+/* Returns false if some peer is left without candidates.                      */
+template <int B>
+bool assign(BoardT<B> &grid, int row, int col, int num, TrailT<B> *trail = nullptr){
+    constexpr int N = B * B;
+    typedef typename BoardT<B>::Mask Mask;
+    int cell = row * N + col;
+    Mask bit = DIGIT_BIT(num);
+    bool consistent = true;
+    if(trail)
+        trail->entries[trail->size++] = {(uint16_t)cell, (uint8_t)num, grid.candidates[cell]};
+    setValue(grid, row, col, num);
+    for(int p : peerTable<B>.peers[cell])
+        if(grid.candidates[p] & bit){
+            grid.candidates[p] &= ~bit;
+            if(trail)
+                trail->entries[trail->size++] = {(uint16_t)p, 0, bit};
+            if(grid.candidates[p] == 0)
+                consistent = false;
+        }
+    return consistent;
+}
+
+/* Removes the digits in mask from the candidates of the cell, logging the change */
+/* in the trail (if any) and setting changed when something was actually removed. */
+/* Returns false if the cell is left without candidates.                          */
+template <int B>
+bool eliminate(BoardT<B> &grid, int cell, typename BoardT<B>::Mask mask, TrailT<B> *trail, bool &changed){
+    typename BoardT<B>::Mask removed = grid.candidates[cell] & mask;
+    if(removed == 0)
+        return true;
+    grid.candidates[cell] &= ~removed;
+    if(trail)
+        trail->entries[trail->size++] = {(uint16_t)cell, 0, removed};
+    changed = true;
+    return grid.candidates[cell] != 0;
+}
+
+/* Rolls the board back to the state it had when the trail size was mark */
+template <int B>
+void undo(BoardT<B> &grid, TrailT<B> &trail, int mark){
+    constexpr int N = B * B;
+    while(trail.size > mark){
+        TrailEntry<B> &e = trail.entries[--trail.size];
+        if(e.num != 0){
+            int row = e.cell / N, col = e.cell % N;
+            typename BoardT<B>::Mask bit = DIGIT_BIT(e.num);
+            grid.value[e.cell] = UNASSIGNED;
+            grid.rows[row] &= ~bit;
+            grid.cols[col] &= ~bit;
+            grid.boxes[boxOf<B>(row, col)] &= ~bit;
+        }
+        grid.candidates[e.cell] |= e.removed;
+    }
+}
+
+/* Cooperative cancellation of the searches running on behalf of the same request:  */
+/* raised once (e.g. when a solution is found), polled by the engines at every node. */
+/* The flag itself is read only every interval nodes, so that the cache line stays   */
+/* shared and the check costs a decrement in the common case.                        */
+struct CancelToken
+{
+    std::atomic<bool> flag{false};
+    int interval = 16;
+
+    void cancel() { flag.store(true, std::memory_order_relaxed); }
+
+    bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+    // countdown belongs to the caller, one per search, so that polling this token
+    // never changes when another one is read
+    bool poll(int &countdown) const
+    {
+        if (--countdown > 0)
+            return false;
+        countdown = interval;
+        return cancelled();
+    }
+};
+
+/* Counts the solutions when the search has to go past the first one, e.g. to check  */
+/* that a schema has only one: limit is how many are enough (0 to count them all),   */
+/* -1 when the search stops at the first one as usual. Every thread counts in its    */
+/* own cache line, the slot of its threadIndex, and reads the others only when it    */
+/* finds a solution, to see if limit has been reached, so exploring the tree shares  */
+/* nothing.                                                                          */
+std::atomic<int> thread_indices{0};
+
+// index of the calling thread, given out in order of first call and the same for every counter
+inline int threadIndex()
+{
+    static thread_local int index = thread_indices.fetch_add(1);
+    return index;
+}
+
+struct SolutionCounter
+{
+    static constexpr int SLOTS = 256;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<long> count{0};
+    };
+
+    long limit = -1;
+    // cancelled once limit solutions have been found
+    CancelToken *token = nullptr;
+    Slot slots[SLOTS];
+
+    bool counting() const { return limit >= 0; }
+
+    // records a solution, true if the search has to stop because limit has been reached
+    bool found()
+    {
+        // threads beyond SLOTS share a slot, the count stays exact
+        slots[threadIndex() % SLOTS].count.fetch_add(1, std::memory_order_relaxed);
+        if (limit == 0 || sum() < limit)
+            return false;
+        if (token != nullptr)
+            token->cancel();
+        return true;
+    }
+
+    // solutions found, at most limit (a few threads may find one more at the same time)
+    long total() const { return limit > 0 ? std::min(sum(), limit) : sum(); }
+
+private:
+    long sum() const
+    {
+        long s = 0;
+        for (int i = 0; i < std::min(thread_indices.load(), SLOTS); i++)
+            s += slots[i].count.load(std::memory_order_relaxed);
+        return s;
+    }
+};
+
+/* A board as read from a file: one byte per cell, UNASSIGNED for the empty ones     */
+template <int B>
+struct PuzzleT
+{
+    static constexpr int N = B * B;
+    uint8_t value[N * N];
+};
+
+/* Binary puzzle file: this header followed by count records of the same size, each  */
+/* one holding a board packed in bits bits per cell (4 for 9x9 boards, 5 for 16x16   */
+/* and 25x25) and, if flags has PUZZLE_FILE_SOLUTIONS, its solution packed the same  */
+/* way (all empty for a board with no solution). Since the records have a fixed      */
+/* size, board i starts at sizeof(PuzzleFileHeader) + i * record size.               */
+#define PUZZLE_FILE_MAGIC "SDKP"
+#define PUZZLE_FILE_VERSION 1
+#define PUZZLE_FILE_SOLUTIONS 1
+
+struct PuzzleFileHeader
+{
+    char magic[4];
+    uint8_t version;
+    uint8_t box;
+    uint8_t bits;
+    uint8_t flags;
+    uint64_t count;
+};
+
+// bits needed to store the values 0..n
+inline int cellBits(int n) { return 32 - __builtin_clz(n); }
+
+inline size_t packedSize(int cells, int bits) { return (cells * bits + 7) / 8; }
+
+template <int B>
+void packPuzzle(const PuzzleT<B> &puzzle, int bits, uint8_t *out)
+{
+    constexpr int N = B * B;
+    uint32_t acc = 0;
+    int pending = 0;
+    for (int i = 0; i < N * N; i++)
+    {
+        acc |= (uint32_t)puzzle.value[i] << pending;
+        for (pending += bits; pending >= 8; pending -= 8, acc >>= 8)
+            *out++ = acc;
+    }
+    if (pending > 0)
+        *out = acc;
+}
+
+template <int B>
+void unpackPuzzle(const uint8_t *in, int bits, PuzzleT<B> &puzzle)
+{
+    constexpr int N = B * B;
+    uint32_t acc = 0;
+    int pending = 0;
+    for (int i = 0; i < N * N; i++)
+    {
+        for (; pending < bits; pending += 8)
+            acc |= (uint32_t)*in++ << pending;
+        puzzle.value[i] = acc & ((1u << bits) - 1);
+        acc >>= bits;
+        pending -= bits;
+    }
+}
+
+/* Decodes a board from a line of text, in either of the formats of the puzzle files */
+/* below; returns the number of cells on the line, the ones missing are left empty   */
+/* and the ones beyond N*N are only counted, or -1 if a value is above N.            */
+template <int B>
+int parsePuzzle(const char *p, const char *line_end, PuzzleT<B> &puzzle)
+{
+    constexpr int N = B * B;
+    memset(puzzle.value, UNASSIGNED, sizeof(puzzle.value));
+    // the format is told by the separators between the cells, not by the ones around them
+    while (p < line_end && isspace((unsigned char)*p))
+        p++;
+    while (line_end > p && isspace((unsigned char)line_end[-1]))
+        line_end--;
+    int cell = 0;
+    if (std::find_if(p, line_end, [](char c) { return isspace((unsigned char)c); }) != line_end)
+        while (p < line_end)
+        {
+            if (*p < '0' || *p > '9')
+            {
+                p++;
+                continue;
+            }
+            int v = 0;
+            for (; p < line_end && *p >= '0' && *p <= '9'; p++)
+                v = std::min(v * 10 + (*p - '0'), N + 1);
+            if (v > N)
+                return -1;
+            if (cell < N * N)
+                puzzle.value[cell] = v;
+            cell++;
+        }
+    else
+        for (; p < line_end; p++)
+        {
+            char c = *p;
+            int v = c >= '1' && c <= '9' ? c - '0'
+                  : c >= 'A' && c <= 'Z' ? c - 'A' + 10
+                  : c >= 'a' && c <= 'z' ? c - 'a' + 10
+                  : UNASSIGNED;
+            if (v > N)
+                return -1;
+            if (cell < N * N)
+                puzzle.value[cell] = v;
+            cell++;
+        }
+    return cell;
+}
+
+/* Line written in place of the solution of a board that has none: a text file of   */
+/* solutions holds either a board or this line for every board of its puzzle file.  */
+#define NO_SOLUTION_LINE "No solution exists"
+
+/* What PuzzleReader::next found: a board, the line of a board with no solution      */
+/* (left empty), a record that is not a board of this size, or the end of the file.  */
+enum ReadResult
+{
+    READ_END,
+    READ_BOARD,
+    READ_NO_SOLUTION,
+    READ_MALFORMED
+};
+
+/* Puzzle file mapped in memory and decoded one board at a time, straight from the   */
+/* mapping: no line is copied and nothing is allocated per value.                    */
+/* A binary file (see above) is recognized by its magic number, skipping boards in   */
+/* it costs nothing. Otherwise every line of the file is a board, holding either the */
+/* N*N values separated by spaces, or N*N characters with '.' or '0' for the empty   */
+/* cells and '1'-'9', then 'A', 'B'... for the values above 9. Blank lines are       */
+/* skipped.                                                                          */
+class PuzzleReader
+{
+private:
+    int fd = -1;
+    const char *data = nullptr;
+    size_t length = 0;
+    const char *cur = nullptr, *end = nullptr;
+    // line (record of a binary file) of the last board read, from 1
+    long position = 0;
+
+    bool binary = false;
+    PuzzleFileHeader header;
+    size_t board_size = 0, record_size = 0;
+
+    // next non blank line in [line, line_end), false at the end of the file
+    bool nextLine(const char *&line, const char *&line_end)
+    {
+        while (cur < end)
+        {
+            line = cur;
+            line_end = (const char *)memchr(cur, '\n', end - cur);
+            if (line_end == nullptr)
+                line_end = end;
+            cur = line_end + 1;
+            position++;
+            for (const char *p = line; p < line_end; p++)
+                if (!isspace((unsigned char)*p))
+                    return true;
+        }
+        return false;
+    }
+
+public:
+    PuzzleReader(const string &filename)
+    {
+        struct stat st;
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0)
+            return;
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            return;
+        length = st.st_size;
+        data = cur = (const char *)map;
+        end = data + length;
+        if (length >= sizeof(header) && memcmp(data, PUZZLE_FILE_MAGIC, 4) == 0)
+        {
+            memcpy(&header, data, sizeof(header));
+            binary = true;
+            cur += sizeof(header);
+            // cells packed in more or fewer bits than their values need, boxes no program
+            // is built for, as well as empty records, make a file as broken as a truncated
+            // one: no board is read from it
+            bool valid = header.version == PUZZLE_FILE_VERSION && header.box > 0 && header.box <= MAX_BOX_SIZE &&
+                         header.bits == cellBits(header.box * header.box);
+            if (valid)
+            {
+                board_size = packedSize(header.box * header.box * header.box * header.box, header.bits);
+                record_size = board_size * (header.flags & PUZZLE_FILE_SOLUTIONS ? 2 : 1);
+            }
+            if (!valid || (size_t)(end - cur) / record_size < header.count)
+                cur = end;
             else
-                dest[r][c].value = source[r][c].value;
+                end = cur + header.count * record_size;
+        }
+        else
+            madvise(map, length, MADV_SEQUENTIAL);
+    }
+
+    ~PuzzleReader()
+    {
+        if (data != nullptr)
+            munmap((void *)data, length);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool hasSolutions() const { return binary && (header.flags & PUZZLE_FILE_SOLUTIONS); }
+
+    // box size of the boards of a binary file, 0 for a text file
+    int boxSize() const { return binary ? header.box : 0; }
+
+    // where the last board read is, for the messages about it: "line 3", "record 3"
+    string where() const { return (binary ? "record " : "line ") + std::to_string(position); }
+
+    // skips n boards, false if the file ends before
+    bool skip(long n)
+    {
+        if (n < 0)
+            return false;
+        if (binary)
+        {
+            // also the end of a file whose header was rejected, with no record size
+            if (cur == end)
+                return n == 0;
+            if (n > (end - cur) / (long)record_size)
+                return false;
+            cur += n * record_size;
+            position += n;
+            return true;
+        }
+        const char *line, *line_end;
+        for (; n > 0; n--)
+            if (!nextLine(line, line_end))
+                return false;
+        return true;
+    }
+
+    // decodes the next board and, if the file has them, its solution (left empty
+    // otherwise). A record that is not a board of NxN values is skipped and reported
+    // as malformed, the following ones can still be read; the boards of a binary file
+    // of another size are not read at all.
+    template <int B>
+    ReadResult next(PuzzleT<B> &puzzle, PuzzleT<B> *solution = nullptr)
+    {
+        constexpr int N = B * B;
+        if (solution != nullptr)
+            memset(solution->value, UNASSIGNED, sizeof(solution->value));
+        if (binary)
+        {
+            if (cur == end || header.box != B)
+                return READ_END;
+            unpackPuzzle((const uint8_t *)cur, header.bits, puzzle);
+            if (solution != nullptr && hasSolutions())
+                unpackPuzzle((const uint8_t *)cur + board_size, header.bits, *solution);
+            cur += record_size;
+            position++;
+            for (int i = 0; i < N * N; i++)
+                if (puzzle.value[i] > N || (solution != nullptr && solution->value[i] > N))
+                    return READ_MALFORMED;
+            return READ_BOARD;
+        }
+        const char *line, *line_end;
+        if (!nextLine(line, line_end))
+            return READ_END;
+        if (parsePuzzle(line, line_end, puzzle) == N * N)
+            return READ_BOARD;
+        memset(puzzle.value, UNASSIGNED, sizeof(puzzle.value));
+        while (isspace((unsigned char)line_end[-1]))
+            line_end--;
+        while (isspace((unsigned char)*line))
+            line++;
+        size_t n = strlen(NO_SOLUTION_LINE);
+        return (size_t)(line_end - line) == n && memcmp(line, NO_SOLUTION_LINE, n) == 0 ? READ_NO_SOLUTION
+                                                                                          : READ_MALFORMED;
     }
+};
+
+/* Writer of binary puzzle files, the number of boards is stored when it is closed   */
+class PuzzleWriter
+{
+private:
+    FILE *file;
+    PuzzleFileHeader header;
+    size_t board_size;
+    std::vector<uint8_t> record;
+
+public:
+    PuzzleWriter(const string &filename, int box, bool solutions)
+    {
+        memcpy(header.magic, PUZZLE_FILE_MAGIC, 4);
+        header.version = PUZZLE_FILE_VERSION;
+        header.box = box;
+        header.bits = cellBits(box * box);
+        header.flags = solutions ? PUZZLE_FILE_SOLUTIONS : 0;
+        header.count = 0;
+        board_size = packedSize(box * box * box * box, header.bits);
+        record.resize(board_size * (solutions ? 2 : 1));
+        file = fopen(filename.c_str(), "wb");
+        if (file != nullptr)
+            fwrite(&header, sizeof(header), 1, file);
+    }
+
+    ~PuzzleWriter()
+    {
+        if (file == nullptr)
+            return;
+        fseek(file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, file);
+        fclose(file);
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    // the solution is ignored if the file was not opened for solutions
+    template <int B>
+    void write(const PuzzleT<B> &puzzle, const PuzzleT<B> *solution = nullptr)
+    {
+        std::fill(record.begin(), record.end(), 0);
+        packPuzzle(puzzle, header.bits, record.data());
+        if (solution != nullptr && (header.flags & PUZZLE_FILE_SOLUTIONS))
+            packPuzzle(*solution, header.bits, record.data() + board_size);
+        fwrite(record.data(), record.size(), 1, file);
+        header.count++;
+    }
+};
+
+/* Board, trail and puzzle of the size this program is compiled for */
+typedef BoardT<BOX_SIZE> Board;
+typedef TrailT<BOX_SIZE> Trail;
+typedef Board::Mask Mask;
+typedef PuzzleT<BOX_SIZE> Puzzle;
+
+constexpr int N = Board::N;
+
+/* Reads all the boards of a file, false (after printing where) at a malformed one */
+bool readGrids(vector<Puzzle> &grids, string filename){
+    PuzzleReader reader(filename);
+    Puzzle puzzle;
+    ReadResult result;
+    while ((result = reader.next(puzzle)) == READ_BOARD)
+        grids.push_back(puzzle);
+    if (result == READ_END)
+        return true;
+    cout << "Malformed schema at " << reader.where() << " of " << filename << endl;
+    return false;
 }
 
-void RemoveSingletons(Cell** &grid){
-    int min = N+1;
-    bool found = true;
-    while(found){
-        found = false;
-        for (int i = 0; i < N; i++)
-            for (int j = 0; j < N; j++)
-                if (grid[i][j].value == UNASSIGNED){
-                    int size = grid[i][j].possible_values.size();
-                    if(size == 1){
-                        grid[i][j].value = grid[i][j].possible_values.back();
-                        grid[i][j].possible_values.clear();
-                        found = true;
-                    }
-                }
-        calculatePossibleValues(grid);
-    }
-}
\ No newline at end of file
+/* Reads only the board in position index of a file, false if there is no such board */
+/* or if it is malformed (after printing where)                                      */
+bool readGrid(Puzzle &grid, string filename, long index){
+    PuzzleReader reader(filename);
+    if (!reader.skip(index))
+        return false;
+    ReadResult result = reader.next(grid);
+    if (result == READ_NO_SOLUTION || result == READ_MALFORMED)
+        cout << "Malformed schema at " << reader.where() << " of " << filename << endl;
+    return result == READ_BOARD;
+}
+
+Board fillGrid(const Puzzle &grid){
+    Board filledGrid = {};
+    for(int row=0;row<N;row++)
+        for(int col=0;col<N;col++)
+            if(grid.value[row * N + col] != UNASSIGNED)
+                setValue(filledGrid, row, col, grid.value[row * N + col]);
+    calculatePossibleValues(filledGrid);
+    return filledGrid;
+}